@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "../common/metrics.h"
 
 #define PORT_ID 14250
 #define BUF_SIZE 4096 // Adjusted buffer size for file reading
@@ -19,6 +20,9 @@ int main(int argc, char *argv[]) {
     FILE *file;
     int read_size;
 
+    metrics_init("tcp_server");
+    metrics_start_exporter();
+
     server_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (server_socket < 0) {
         perror("[-] Socket error");
@@ -43,7 +47,10 @@ int main(int argc, char *argv[]) {
     while (1) {
         addr_size = sizeof(client_addr);
         client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &addr_size);
-        printf("[+] Client Connected\n");
+        uint64_t accepted_us = metrics_now_us();
+        int first_send = 1;
+        metrics_add(M_CONNECTIONS, 1);
+        PACKET_LOG("[+] Client Connected\n");
 
         // Open the file you wish to send
         file = fopen("example.txt", "rb");
@@ -54,7 +61,15 @@ int main(int argc, char *argv[]) {
 
         // Read file contents and send
         while ((read_size = fread(buffer, 1, BUF_SIZE, file)) > 0) {
-            send(client_socket, buffer, read_size, 0);
+            ssize_t sent = send(client_socket, buffer, read_size, 0);
+            if (sent > 0) {
+                metrics_add(M_BYTES_SENT, sent);
+                metrics_add(M_PACKETS_SENT, 1);
+                if (first_send) {
+                    metrics_record(M_TTFB_US, metrics_now_us() - accepted_us);
+                    first_send = 0;
+                }
+            }
         }
 
         // Close the file
@@ -65,7 +80,8 @@ int main(int argc, char *argv[]) {
         send(client_socket, buffer, strlen(buffer), 0);
 
         close(client_socket);
-        printf("[+] Client disconnected.\n\n");
+        metrics_record(M_TRANSFER_US, metrics_now_us() - accepted_us);
+        PACKET_LOG("[+] Client disconnected.\n\n");
     }
 
     return 0;
@@ -7,6 +7,7 @@
 #include <errno.h>      // Defines macros for reporting and retrieving error conditions
 #include <signal.h>     // Signal handling definitions
 #include "packetStruct.c"  // Include the Go-Back-N packet structure definitions
+#include "../common/metrics.h"  // Shared counters and histograms
 #include <sys/select.h>  // For select()
 
 // Defines for timeout, maximum tries, and hardcoded user inputs
@@ -48,12 +49,13 @@ void sendPackets(int sock, struct sockaddr_in gbnServAddr, struct packetStruct p
     fd_set readfds;
     int maxfd = sock + 1;
     int waitForAckFor = 0; // This represents the lowest packet in the window for which ACK is awaited.
+    int highestSent = -1; // Highest sequence number sent so far, to tell retransmissions apart
 
     while (sendBase < nPackets) {
         // Send packets within the window
         while (sendBase + waitForAckFor < sendBase + WINDOW_SIZE && sendBase + waitForAckFor < nPackets) {
             int seqNum = sendBase + waitForAckFor;
-            printf("Sending packet %d\n", seqNum);
+            PACKET_LOG("Sending packet %d\n", seqNum);
             packets[seqNum].seq_no = seqNum;
             
             if (sendto(sock, &packets[seqNum], sizeof(struct packetStruct), 0, 
@@ -63,7 +65,14 @@ void sendPackets(int sock, struct sockaddr_in gbnServAddr, struct packetStruct p
                 close(sock);
                 exit(EXIT_FAILURE);
             }
-            printf("Packet %d sent\n", seqNum);
+            metrics_add(M_PACKETS_SENT, 1);
+            metrics_add(M_BYTES_SENT, sizeof(struct packetStruct));
+            if (seqNum <= highestSent) {
+                metrics_add(M_RETRANSMITS, 1);
+            } else {
+                highestSent = seqNum;
+            }
+            PACKET_LOG("Packet %d sent\n", seqNum);
             waitForAckFor++;
         }
 
@@ -82,15 +91,18 @@ void sendPackets(int sock, struct sockaddr_in gbnServAddr, struct packetStruct p
             // ACK is available to be read
             struct packetStruct ackPacket;
             if (recvfrom(sock, &ackPacket, sizeof(ackPacket), 0, NULL, NULL) > 0) {
+                metrics_add(M_PACKETS_RECEIVED, 1);
+                metrics_add(M_BYTES_RECEIVED, sizeof(ackPacket));
+                metrics_record(M_QUEUE_DEPTH, waitForAckFor); // Packets in flight when the ACK arrived
                 if (ackPacket.type == 2 && ackPacket.seq_no == sendBase) { // Ensure ACK is for the lowest packet
-                    printf("ACK received for packet %d\n", ackPacket.seq_no);
+                    PACKET_LOG("ACK received for packet %d\n", ackPacket.seq_no);
                     sendBase++; // Move window forward only for the lowest acknowledged packet
                     waitForAckFor--; // Adjust waitForAckFor since the window has slid forward
                 }
             }
         } else {
             // Timeout occurred
-            printf("Timeout, resending packets starting from %d\n", sendBase);
+            PACKET_LOG("Timeout, resending packets starting from %d\n", sendBase);
             // Reset waitForAckFor to start resending packets from the lowest unacknowledged one
             waitForAckFor = 0;
         }
@@ -100,15 +112,11 @@ void sendPackets(int sock, struct sockaddr_in gbnServAddr, struct packetStruct p
 
 int main(int argc, char *arg[]) {
     printf("Client: Starting...\n");
+    metrics_init("gbn_client");
     // Local variables for socket communication, now using hardcoded values
     int sock;                       // Socket descriptor
     struct sockaddr_in gbnServAddr; // Go-Back-N server address structure
-    struct sockaddr_in fromAddr;    // Structure for storing the source address
-    unsigned int fromSize;          // Size of the from address structure
     struct sigaction myAction;      // Structure to define signal action
-    int respLen;                    // Length of the received datagram
-    int packet_received = -1;       // Index of the highest acknowledgment received
-    int packet_sent = -1;           // Index of the highest packet sent
     char buffer[8192];              // Buffer to store the data to be sent
     const int chunkSize = CHUNK_SIZE; // Now using a constant value
     int nPackets = 0;               // Number of packets to send, calculated based on chunkSize
@@ -150,7 +158,7 @@ int main(int argc, char *arg[]) {
         packets[i] = createPacket(&buffer[startIndex], currentChunkLength, i);
 
         // Example: Printing packet data to verify
-        printf("Packet created %d: %s\n", packets[i].seq_no, packets[i].data);
+        PACKET_LOG("Packet created %d: %s\n", packets[i].seq_no, packets[i].data);
     }
     
     // Create a UDP socket
@@ -175,7 +183,10 @@ int main(int argc, char *arg[]) {
     gbnServAddr.sin_addr.s_addr = inet_addr(SERVER_IP); // Server IP address
     gbnServAddr.sin_port = htons(SERVER_PORT); // Server port
 
+    uint64_t transferStart = metrics_now_us();
     sendPackets(sock, gbnServAddr, packets, nPackets);
+    metrics_record(M_TRANSFER_US, metrics_now_us() - transferStart);
+    metrics_write_snapshot(stderr); // Short-lived, so print the totals; stderr keeps the assignment output unchanged
     //printf("File content sent to the server successfully.\n");
 
     printf("Client: Closing the socket...\n");
@@ -7,6 +7,7 @@
 #include <errno.h>      // Defines macros for reporting and retrieving error conditions
 #include <signal.h>     // Signal handling definitions
 #include "packetStruct.c"  // Include the Go-Back-N packet structure definitions
+#include "../common/metrics.h"  // Shared counters and histograms
 
 // Define constants for the server port and chunk size
 #define SERVER_PORT 12345       
@@ -21,7 +22,6 @@ void CatchAlarm(int ignored);
 
 int main(int argc, char **argv) {
     printf("Server: Starting...\n");
-    char buffer[MAX_PACKET_SIZE]; // Buffer for storing received data
     int sock;                      // Socket descriptor for the server
     struct sockaddr_in gbnServAddr, gbnClntAddr; // Structs for server and client address
     unsigned int cliAddrLen;      // Variable for storing the length of the client address
@@ -31,6 +31,9 @@ int main(int argc, char **argv) {
     printf("Enter your desired packet loss rate (e.g., 0.5 for 50%%): ");
     scanf("%lf", &lossRate);
 
+    metrics_init("gbn_server");
+    metrics_start_exporter();
+
     // Create a UDP socket
 printf("Server: Creating socket...\n");
     sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
@@ -57,25 +60,29 @@ printf("Server: Closing the connection...\n");
 
     // Main loop to handle incoming packets indefinitely
    while (1) {
-    printf("Listening.....\n");
+    PACKET_LOG("Listening.....\n");
     struct packetStruct currPacket; // Packet struct to store incoming data
     cliAddrLen = sizeof(gbnClntAddr);
 
     // Block and wait for incoming data, directly into currPacket
-    if (recvfrom(sock, &currPacket, sizeof(currPacket), 0,
-                 (struct sockaddr *)&gbnClntAddr, &cliAddrLen) < 0) {
+    ssize_t received = recvfrom(sock, &currPacket, sizeof(currPacket), 0,
+                                (struct sockaddr *)&gbnClntAddr, &cliAddrLen);
+    if (received < 0) {
         perror("recvfrom() failed");
         continue; // In case of error, log and try to receive again
     }
+    metrics_add(M_PACKETS_RECEIVED, 1);
+    metrics_add(M_BYTES_RECEIVED, received);
 
     // Simulate packet loss based on the specified rate
     if (lossRate > ((double)rand() / RAND_MAX)) {
-        printf("Packet with sequence number %d lost\n", currPacket.seq_no);
+        metrics_add(M_PACKETS_DROPPED, 1);
+        PACKET_LOG("Packet with sequence number %d lost\n", currPacket.seq_no);
         continue; // Skip further processing for this packet
     }
 
     // Assuming type 1 is data and type 2 is an ack for simplification
-    printf("Received packet: Seq No %d, Length %d, Data: %s\n", 
+    PACKET_LOG("Received packet: Seq No %d, Length %d, Data: %s\n", 
            currPacket.seq_no, currPacket.length, currPacket.data);
 
     if (currPacket.type == 1) { // Check if the packet is a data packet
@@ -90,7 +97,9 @@ printf("Server: Closing the connection...\n");
                    (struct sockaddr *)&gbnClntAddr, sizeof(gbnClntAddr)) < 0) {
             perror("sendto() failed while sending ACK");
         } else {
-            printf("ACK sent for packet with sequence number %d\n", ackPacket.seq_no);
+            metrics_add(M_PACKETS_SENT, 1);
+            metrics_add(M_BYTES_SENT, sizeof(ackPacket));
+            PACKET_LOG("ACK sent for packet with sequence number %d\n", ackPacket.seq_no);
         }
     }
     // Other logic for different packet types would go here
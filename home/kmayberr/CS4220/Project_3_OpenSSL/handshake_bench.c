@@ -0,0 +1,292 @@
+/***********************************************************************
+ * handshake_bench.c
+ *
+ * A load generator for http_server.c that mixes two kinds of clients:
+ * - handshake clients open a new connection for every request, so each
+ *   request costs a full SSL handshake (and an RSA signature on the server);
+ * - data clients keep one connection open and send requests back to back.
+ * After the run, the latency percentiles of both kinds are printed. Running
+ * it against "http_server -e" and "http_server -a" shows how much the data
+ * clients' tail latency suffers when handshake crypto runs on the event
+ * loop, and how much offloading it to crypto threads recovers.
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ *
+ *
+ * Notes:
+ * - The benchmark connects to localhost on port 4433.
+ * - Sessions are never resumed, so every handshake client connection is a
+ *   full handshake.
+ ***********************************************************************/
+#define _GNU_SOURCE // For strcasestr
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#define PORT 4433 // Define the server port the benchmark will connect to
+#define SERVER "127.0.0.1"  // IP address of the server
+#define MAX_CLIENTS 256 // Upper bound on handshake plus data clients
+#define RESPONSE_BUF_SIZE 4096 // Largest response the benchmark expects
+
+volatile int running = 1; // Cleared when the measurement period ends
+
+// Latency samples collected by one client thread
+struct client {
+    pthread_t thread;
+    SSL_CTX *ctx;
+    int keep_alive;    // 1 for a data client, 0 for a handshake client
+    double *samples;   // Request latencies in milliseconds
+    int nsamples;
+    int capacity;
+    int errors;        // Failed connections or requests
+};
+
+// Return the current monotonic time in milliseconds
+double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Record one latency sample
+void add_sample(struct client *c, double ms) {
+    if (c->nsamples == c->capacity) {
+        c->capacity = c->capacity ? c->capacity * 2 : 1024;
+        c->samples = realloc(c->samples, c->capacity * sizeof(double));
+        if (!c->samples) {
+            perror("Unable to allocate samples");
+            exit(EXIT_FAILURE);
+        }
+    }
+    c->samples[c->nsamples++] = ms;
+}
+
+// Open a TCP connection to the server and perform the SSL handshake; returns NULL on failure
+SSL *connect_ssl(SSL_CTX *ctx) {
+    struct sockaddr_in addr;
+    int on = 1;
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        return NULL;
+    }
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = inet_addr(SERVER);
+    if (connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sockfd);
+        return NULL;
+    }
+
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, sockfd);
+    if (SSL_connect(ssl) != 1) {
+        ERR_clear_error();
+        SSL_free(ssl);
+        close(sockfd);
+        return NULL;
+    }
+    return ssl;
+}
+
+// Close a connection opened by connect_ssl
+void disconnect_ssl(SSL *ssl) {
+    int sockfd = SSL_get_fd(ssl);
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(sockfd);
+}
+
+// Send one request and read the whole response; returns 0 on success, 1 if the server then closes
+// the connection, or -1 on failure
+int request(SSL *ssl, int keep_alive) {
+    const char *req = keep_alive
+        ? "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        : "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    char buf[RESPONSE_BUF_SIZE];
+    int len = 0;
+
+    if (SSL_write(ssl, req, strlen(req)) <= 0) {
+        return -1;
+    }
+
+    // The server always sends Content-Length, so read until the head and that many body bytes arrived
+    while (len < (int)sizeof(buf) - 1) {
+        int n = SSL_read(ssl, buf + len, sizeof(buf) - 1 - len);
+        if (n <= 0) {
+            return -1;
+        }
+        len += n;
+        buf[len] = '\0';
+
+        char *body = strstr(buf, "\r\n\r\n");
+        char *cl = strcasestr(buf, "Content-Length:");
+        if (body && cl && len - (body + 4 - buf) >= atoi(cl + 15)) {
+            return strcasestr(buf, "\r\nConnection: close") ? 1 : 0;
+        }
+    }
+    return -1;
+}
+
+// Client thread: issue requests until the measurement period ends
+void *client_main(void *arg) {
+    struct client *c = arg;
+    SSL *ssl = NULL;
+
+    while (running) {
+        double start = now_ms();
+        if (!ssl) {
+            ssl = connect_ssl(c->ctx);
+            if (!ssl) {
+                c->errors++;
+                usleep(1000);
+                continue;
+            }
+            if (c->keep_alive) {
+                start = now_ms(); // Data clients only time requests, not the initial handshake
+            }
+        }
+
+        int rc = request(ssl, c->keep_alive);
+        double elapsed = now_ms() - start;
+        if (rc >= 0) {
+            add_sample(c, elapsed);
+        } else {
+            c->errors++;
+        }
+        if (rc != 0 || !c->keep_alive) {
+            disconnect_ssl(ssl);
+            ssl = NULL;
+        }
+    }
+
+    if (ssl) {
+        disconnect_ssl(ssl);
+    }
+    return NULL;
+}
+
+// Compare two doubles for qsort
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Merge the samples of clients [first, first + n) and print their rate and latency percentiles
+void report(const char *label, struct client *clients, int first, int n, double seconds) {
+    int total = 0, errors = 0;
+    for (int i = first; i < first + n; i++) {
+        total += clients[i].nsamples;
+        errors += clients[i].errors;
+    }
+    if (n == 0) {
+        return;
+    }
+    if (total == 0) {
+        printf("%-10s no completed requests (%d errors)\n", label, errors);
+        return;
+    }
+
+    double *all = malloc(total * sizeof(double));
+    int k = 0;
+    for (int i = first; i < first + n; i++) {
+        memcpy(all + k, clients[i].samples, clients[i].nsamples * sizeof(double));
+        k += clients[i].nsamples;
+    }
+    qsort(all, total, sizeof(double), compare_double);
+
+    printf("%-10s %8d %9.1f %8.2f %8.2f %8.2f %8.2f %8.2f %7d\n", label, total, total / seconds,
+           all[(int)(total * 0.50)], all[(int)(total * 0.90)], all[(int)(total * 0.99)],
+           all[(int)(total * 0.999)], all[total - 1], errors);
+    free(all);
+}
+
+// Print command line usage
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-H handshake_clients] [-D data_clients] [-d seconds]\n", prog);
+    fprintf(stderr, "  -H N      clients doing a full handshake per request (default 4)\n");
+    fprintf(stderr, "  -D N      clients sending requests on one kept-alive connection (default 4)\n");
+    fprintf(stderr, "  -d N      measurement period in seconds (default 10)\n");
+    exit(EXIT_FAILURE);
+}
+
+// Main function to start the clients, wait for the measurement period, and report
+int main(int argc, char **argv) {
+    int nhandshake = 4, ndata = 4, duration = 10;
+    struct client clients[MAX_CLIENTS];
+    SSL_CTX *ctx;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:D:d:")) != -1) {
+        switch (opt) {
+        case 'H':
+            nhandshake = atoi(optarg);
+            break;
+        case 'D':
+            ndata = atoi(optarg);
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (nhandshake < 0 || ndata < 0 || nhandshake + ndata == 0 || nhandshake + ndata > MAX_CLIENTS || duration < 1) {
+        usage(argv[0]);
+    }
+
+    signal(SIGPIPE, SIG_IGN); // A server closing a connection must not kill the benchmark
+    SSL_load_error_strings();
+    OpenSSL_add_ssl_algorithms();
+    ctx = SSL_CTX_new(TLS_client_method());
+    if (!ctx) {
+        ERR_print_errors_fp(stderr);
+        exit(EXIT_FAILURE);
+    }
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF); // Force a full handshake every time
+
+    printf("Running %d handshake and %d data client(s) for %d second(s)...\n", nhandshake, ndata, duration);
+    memset(clients, 0, sizeof(clients));
+    for (int i = 0; i < nhandshake + ndata; i++) {
+        clients[i].ctx = ctx;
+        clients[i].keep_alive = (i >= nhandshake);
+        if (pthread_create(&clients[i].thread, NULL, client_main, &clients[i]) != 0) {
+            perror("Unable to create client thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    sleep(duration);
+    running = 0;
+    for (int i = 0; i < nhandshake + ndata; i++) {
+        pthread_join(clients[i].thread, NULL);
+    }
+
+    printf("\n%-10s %8s %9s %8s %8s %8s %8s %8s %7s\n",
+           "client", "requests", "req/s", "p50(ms)", "p90(ms)", "p99(ms)", "p99.9", "max", "errors");
+    report("handshake", clients, 0, nhandshake, duration);
+    report("data", clients, nhandshake, ndata, duration);
+
+    for (int i = 0; i < nhandshake + ndata; i++) {
+        free(clients[i].samples);
+    }
+    SSL_CTX_free(ctx);
+    return 0;
+}
@@ -3,8 +3,12 @@
  * 
  * A simple HTTPS client implementation using OpenSSL to demonstrate secure
  * communication over a network. This client connects to a specified server,
- * performs an SSL handshake, sends an HTTP GET request, and prints the server's
- * response.
+ * performs an SSL handshake, sends HTTP GET requests, and streams each response
+ * body to stdout or a file. Bodies may be delimited by Content-Length, chunked
+ * transfer-encoding, or the server closing the connection, and are never
+ * buffered in full. With -c, the paths are fetched in parallel over a pool of
+ * persistent connections. Latency and throughput statistics are printed for
+ * every request.
  *
  * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
  * 
@@ -18,10 +22,17 @@
  * - Ensure OpenSSL is correctly installed and configured on the system where this is run.
  * - This client is configured to connect to localhost on port 4433.
  ***********************************************************************/
+#define _GNU_SOURCE // For strcasestr
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -30,6 +41,8 @@
 
 #define PORT 4433 // Define the server port the client will connect to
 #define SERVER "127.0.0.1"  // IP address of the server
+#define READ_BUF_SIZE 16384 // Size of the streaming read buffer, one full TLS record
+#define MAX_CONNECTIONS 64 // Upper bound on the parallel connection pool
 
 // Initialize OpenSSL by loading error strings and algorithms
 void init_openssl() {
@@ -64,6 +77,11 @@ SSL_CTX *create_context() {
         exit(EXIT_FAILURE);
     }
 
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // Servers often close without close_notify after a close-delimited body; treat that as a normal EOF
+    SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
     printf("SSL context created and configured with AES 256-bit encryption.\n");
     return ctx;
 }
@@ -94,55 +112,530 @@ int open_connection(const char *hostname, int port) {
     return sockfd;
 }
 
-// Send an HTTP GET request and print the server's response
-void perform_request(SSL *ssl) {
-    const char *request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
-    char buffer[1024] = {0};
 
-    printf("Sending request...\n");
-    if (SSL_write(ssl, request, strlen(request)) <= 0) { // Write the request to the SSL connection
-        ERR_print_errors_fp(stderr); // Print SSL errors
+// Return the current monotonic time in milliseconds
+double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// A persistent SSL connection to the server, reused across requests when possible
+struct connection {
+    int sockfd;   // Socket file descriptor, -1 when not connected
+    SSL *ssl;     // SSL connection state
+    int requests; // Number of requests already sent on this connection
+};
+
+// Open the TCP connection and perform the SSL handshake
+void connect_ssl(SSL_CTX *ctx, struct connection *conn) {
+    conn->sockfd = open_connection(SERVER, PORT); // Open connection to the server
+    conn->ssl = SSL_new(ctx); // Create a new SSL connection state
+    conn->requests = 0;
+    SSL_set_fd(conn->ssl, conn->sockfd); // Associate the connection with the file descriptor
+
+    printf("Starting SSL handshake...\n");
+    if (SSL_connect(conn->ssl) != 1) { // Perform the SSL handshake
+        ERR_print_errors_fp(stderr);
         exit(EXIT_FAILURE);
     }
+    printf("SSL handshake completed.\n");
+}
+
+// Shut down and free a connection so the next request opens a fresh one
+void disconnect_ssl(struct connection *conn) {
+    if (conn->ssl) {
+        SSL_shutdown(conn->ssl);
+        SSL_free(conn->ssl);
+        conn->ssl = NULL;
+    }
+    if (conn->sockfd >= 0) {
+        close(conn->sockfd);
+        conn->sockfd = -1;
+    }
+}
+
+// Buffered reader that pulls decrypted bytes from the SSL connection on demand
+struct response_reader {
+    SSL *ssl;
+    char buf[READ_BUF_SIZE]; // Decrypted bytes not yet consumed
+    size_t start, end;       // Unconsumed bytes are buf[start..end)
+    int eof;                 // Set once the peer has closed the connection
+    double first_byte_ms;    // Time the first response byte arrived, 0 until then
+};
+
+// Per-request timing and size statistics
+struct request_stats {
+    const char *path;   // Requested path
+    int status;         // HTTP status code, 0 if the request failed
+    long long bytes;    // Body bytes delivered to the sink
+    int reused;         // 1 if the request ran on an already open connection
+    int keep_alive;     // 1 if the connection may be reused afterwards
+    double start_ms;    // Time the request was started
+    double ttfb_ms;     // Time to first byte, measured from start_ms
+    double total_ms;    // Time until the body was fully read, measured from start_ms
+};
+
+// Refill the reader's buffer with one SSL_read; returns bytes read, 0 on EOF, -1 on error
+int reader_fill(struct response_reader *r) {
+    if (r->eof) {
+        return 0;
+    }
+    if (r->start == r->end) {
+        r->start = r->end = 0; // Everything consumed, reuse the whole buffer
+    } else if (r->end == sizeof(r->buf)) {
+        memmove(r->buf, r->buf + r->start, r->end - r->start); // Make room after a partial line
+        r->end -= r->start;
+        r->start = 0;
+    }
+    if (r->end == sizeof(r->buf)) {
+        fprintf(stderr, "Response line longer than %d bytes.\n", READ_BUF_SIZE);
+        return -1;
+    }
+
+    int n = SSL_read(r->ssl, r->buf + r->end, sizeof(r->buf) - r->end);
+    if (n <= 0) {
+        int err = SSL_get_error(r->ssl, n);
+        if (err == SSL_ERROR_ZERO_RETURN || err == SSL_ERROR_SYSCALL) {
+            ERR_clear_error(); // Peer closed the connection, with or without close_notify
+            r->eof = 1;
+            return 0;
+        }
+        ERR_print_errors_fp(stderr);
+        return -1;
+    }
+    if (r->first_byte_ms == 0) {
+        r->first_byte_ms = now_ms();
+    }
+    r->end += n;
+    return n;
+}
+
+// Read one CRLF-terminated line (without the CRLF); returns its length or -1
+int reader_getline(struct response_reader *r, char *line, size_t size) {
+    while (1) {
+        char *nl = memchr(r->buf + r->start, '\n', r->end - r->start);
+        if (nl) {
+            size_t len = nl - (r->buf + r->start);
+            size_t copy = len;
+            if (copy > 0 && r->buf[r->start + copy - 1] == '\r') {
+                copy--; // Drop the carriage return
+            }
+            if (copy >= size) {
+                copy = size - 1; // Truncate overly long header lines
+            }
+            memcpy(line, r->buf + r->start, copy);
+            line[copy] = '\0';
+            r->start += len + 1;
+            return (int)copy;
+        }
+        if (reader_fill(r) <= 0) {
+            return -1;
+        }
+    }
+}
+
+// Stream up to max bytes (or until EOF when max < 0) from the connection to the sink
+long long reader_copy(struct response_reader *r, long long max, FILE *sink) {
+    long long copied = 0;
+    while (max < 0 || copied < max) {
+        if (r->start == r->end) {
+            int n = reader_fill(r);
+            if (n < 0) {
+                return -1;
+            }
+            if (n == 0) {
+                break; // EOF
+            }
+        }
+        size_t avail = r->end - r->start;
+        if (max >= 0 && (long long)avail > max - copied) {
+            avail = max - copied;
+        }
+        if (sink && fwrite(r->buf + r->start, 1, avail, sink) != avail) {
+            perror("Unable to write response body");
+            return -1;
+        }
+        r->start += avail;
+        copied += avail;
+    }
+    return copied;
+}
+
+// Parse a non-negative decimal or hex number that may be followed by whitespace or, for chunk sizes,
+// ";extensions"; returns -1 if there are no digits, the value is negative or too large, or junk follows
+long long parse_length(const char *text, int base) {
+    char *end;
+    while (*text == ' ' || *text == '\t') {
+        text++;
+    }
+    if (!isxdigit((unsigned char)*text) || (base == 10 && !isdigit((unsigned char)*text))) {
+        return -1; // Rejects empty values and signs
+    }
+    errno = 0;
+    long long value = strtoll(text, &end, base);
+    while (*end == ' ' || *end == '\t') {
+        end++;
+    }
+    if (errno == ERANGE || (*end != '\0' && !(base == 16 && *end == ';'))) {
+        return -1;
+    }
+    return value;
+}
+
+// Read the status line, headers, and body of one response, streaming the body to the sink
+int read_response(struct response_reader *r, FILE *sink, struct request_stats *stats) {
+    char line[1024];
+    long long content_length; // -1 means the body is not length delimited
+    int chunked;
+    int minor_version = 0;
+
+    // Interim 1xx responses carry no body and are followed by the real response
+    do {
+        content_length = -1;
+        chunked = 0;
+        if (reader_getline(r, line, sizeof(line)) < 0) {
+            return -1;
+        }
+        if (sscanf(line, "HTTP/1.%d %d", &minor_version, &stats->status) != 2) {
+            fprintf(stderr, "Malformed status line: %s\n", line);
+            return -1;
+        }
+        if (stats->status == 101) {
+            fprintf(stderr, "Unexpected protocol switch: %s\n", line);
+            return -1;
+        }
+        stats->keep_alive = (minor_version >= 1); // HTTP/1.1 keeps the connection open by default
+
+        // Parse headers until the blank line
+        while (1) {
+            int len = reader_getline(r, line, sizeof(line));
+            if (len < 0) {
+                return -1;
+            }
+            if (len == 0) {
+                break;
+            }
+            if (strncasecmp(line, "Content-Length:", 15) == 0) {
+                content_length = parse_length(line + 15, 10);
+                if (content_length < 0) {
+                    fprintf(stderr, "Invalid %s\n", line);
+                    return -1;
+                }
+            } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strcasestr(line + 18, "chunked")) {
+                chunked = 1;
+            } else if (strncasecmp(line, "Connection:", 11) == 0) {
+                if (strcasestr(line + 11, "close")) {
+                    stats->keep_alive = 0;
+                } else if (strcasestr(line + 11, "keep-alive")) {
+                    stats->keep_alive = 1;
+                }
+            }
+        }
+    } while (stats->status >= 100 && stats->status < 200);
+
+    if (stats->status == 204 || stats->status == 304) {
+        // These never have a body, whatever the headers say
+    } else if (chunked) {
+        // Each chunk is "<hex size>\r\n<data>\r\n", terminated by a zero-size chunk and trailers
+        while (1) {
+            if (reader_getline(r, line, sizeof(line)) < 0) {
+                return -1;
+            }
+            long long size = parse_length(line, 16);
+            if (size < 0) {
+                fprintf(stderr, "Invalid chunk size: %s\n", line);
+                return -1;
+            }
+            if (size == 0) {
+                break;
+            }
+            long long got = reader_copy(r, size, sink);
+            if (got != size) {
+                fprintf(stderr, "Connection closed mid-chunk.\n");
+                return -1;
+            }
+            stats->bytes += got;
+            if (reader_getline(r, line, sizeof(line)) < 0) { // CRLF after the chunk data
+                return -1;
+            }
+        }
+        do { // Skip trailers up to the final blank line
+            if (reader_getline(r, line, sizeof(line)) < 0) {
+                return -1;
+            }
+        } while (line[0] != '\0');
+    } else if (content_length >= 0) {
+        long long got = reader_copy(r, content_length, sink);
+        if (got != content_length) {
+            fprintf(stderr, "Connection closed after %lld of %lld body bytes.\n", got < 0 ? 0 : got, content_length);
+            return -1;
+        }
+        stats->bytes += got;
+    } else {
+        // No length information: the body runs until the server closes the connection
+        long long got = reader_copy(r, -1, sink);
+        if (got < 0) {
+            return -1;
+        }
+        stats->bytes += got;
+        stats->keep_alive = 0;
+    }
 
-    printf("Request sent. Waiting for response...\n");
-    if (SSL_read(ssl, buffer, sizeof(buffer) - 1) <= 0) { // Read the server's response
+    if (sink) {
+        fflush(sink);
+    }
+    return 0;
+}
+
+// Send an HTTP GET request for path and stream the response body to sink
+int perform_request(struct connection *conn, const char *path, FILE *sink, struct request_stats *stats) {
+    char request[1024];
+    struct response_reader *reader;
+    int len, rc;
+
+    len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n", path);
+    if (len < 0 || len >= (int)sizeof(request)) {
+        fprintf(stderr, "Request path too long: %s\n", path);
+        return -1;
+    }
+
+    if (SSL_write(conn->ssl, request, len) <= 0) { // Write the request to the SSL connection
         ERR_print_errors_fp(stderr); // Print SSL errors
+        return -1;
+    }
+    conn->requests++;
+
+    reader = calloc(1, sizeof(*reader)); // Heap allocated, the read buffer is too big for worker stacks
+    if (!reader) {
+        perror("Unable to allocate response reader");
         exit(EXIT_FAILURE);
     }
+    reader->ssl = conn->ssl;
+
+    rc = read_response(reader, sink, stats);
+    if (reader->first_byte_ms) {
+        stats->ttfb_ms = reader->first_byte_ms - stats->start_ms;
+    }
+    if (reader->start != reader->end) {
+        stats->keep_alive = 0; // Unexpected extra bytes, the connection can no longer be trusted
+    }
+    free(reader);
+    return rc;
+}
+
+// Fetch one path, opening a connection if needed and retrying once if a reused connection went stale
+void fetch(SSL_CTX *ctx, struct connection *conn, const char *path, FILE *sink, struct request_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->path = path;
+    stats->start_ms = now_ms();
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        stats->reused = (conn->ssl != NULL);
+        if (!conn->ssl) {
+            connect_ssl(ctx, conn);
+        }
+        int rc = perform_request(conn, path, sink, stats);
+        stats->total_ms = now_ms() - stats->start_ms;
+        if (rc == 0 && stats->keep_alive) {
+            return; // Keep the connection for the next request
+        }
+        disconnect_ssl(conn);
+        // Only a reused connection that produced nothing is worth retrying
+        if (rc == 0 || !stats->reused || stats->status != 0 || stats->bytes != 0) {
+            if (rc != 0) {
+                stats->status = 0;
+            }
+            return;
+        }
+    }
+}
+
+// Work shared by the threads of the connection pool
+struct fetch_job {
+    SSL_CTX *ctx;
+    char **paths;                 // Paths to fetch
+    int npaths;
+    const char *output;           // Output file prefix, NULL to discard bodies
+    struct request_stats *stats;  // One entry per path
+    int next;                     // Index of the next path to hand out
+    pthread_mutex_t lock;         // Protects next
+};
+
+// Pool thread: keep one persistent connection and fetch paths until none are left
+void *fetch_worker(void *arg) {
+    struct fetch_job *job = arg;
+    struct connection conn = { -1, NULL, 0 };
+
+    while (1) {
+        pthread_mutex_lock(&job->lock);
+        int i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->npaths) {
+            break;
+        }
+
+        FILE *sink = NULL;
+        if (job->output) {
+            char name[4096];
+            snprintf(name, sizeof(name), "%s.%d", job->output, i);
+            sink = fopen(name, "wb");
+            if (!sink) {
+                perror("Unable to open output file");
+                exit(EXIT_FAILURE);
+            }
+        }
+        fetch(job->ctx, &conn, job->paths[i], sink, &job->stats[i]);
+        if (sink) {
+            fclose(sink);
+        }
+    }
+
+    disconnect_ssl(&conn);
+    return NULL;
+}
+
+// Compare two doubles for qsort
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Print per-request statistics and a summary of latency and throughput
+void print_stats(struct request_stats *stats, int n, double wall_ms) {
+    double *latency = malloc(n * sizeof(double));
+    long long total_bytes = 0;
+    int ok = 0;
+
+    fprintf(stderr, "\n%-4s %-24s %6s %12s %10s %10s %10s %s\n",
+            "#", "path", "status", "bytes", "ttfb(ms)", "total(ms)", "MB/s", "conn");
+    for (int i = 0; i < n; i++) {
+        struct request_stats *s = &stats[i];
+        double mbps = s->total_ms > 0 ? (s->bytes / 1048576.0) / (s->total_ms / 1000.0) : 0;
+        fprintf(stderr, "%-4d %-24s %6d %12lld %10.2f %10.2f %10.2f %s\n",
+                i, s->path, s->status, s->bytes, s->ttfb_ms, s->total_ms, mbps, s->reused ? "reused" : "new");
+        if (s->status != 0) {
+            latency[ok++] = s->total_ms;
+            total_bytes += s->bytes;
+        }
+    }
+
+    fprintf(stderr, "\n%d/%d requests succeeded, %lld bytes in %.2f ms (%.2f MB/s, %.1f req/s)\n",
+            ok, n, total_bytes, wall_ms,
+            wall_ms > 0 ? (total_bytes / 1048576.0) / (wall_ms / 1000.0) : 0,
+            wall_ms > 0 ? ok / (wall_ms / 1000.0) : 0);
+    if (ok > 0) {
+        qsort(latency, ok, sizeof(double), compare_double);
+        fprintf(stderr, "Latency (ms): min %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+                latency[0], latency[ok / 2], latency[(int)(ok * 0.9)], latency[(int)(ok * 0.99)], latency[ok - 1]);
+    }
+    free(latency);
+}
 
-    printf("Response received:\n%s\n", buffer); // Print the response
+// Print command line usage
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-c connections] [-o output] [path ...]\n", prog);
+    fprintf(stderr, "  -c N      fetch the paths in parallel over a pool of N persistent connections\n");
+    fprintf(stderr, "  -o FILE   write the body to FILE (FILE.<index> for each path with -c)\n");
+    fprintf(stderr, "  path      request paths, defaults to /\n");
+    exit(EXIT_FAILURE);
 }
 
-// Main function to setup SSL and perform the request
+// Main function to setup SSL and perform the requests
 int main(int argc, char **argv) {
-    int server_fd; // Server socket file descriptor
     SSL_CTX *ctx; // SSL context
-    SSL *ssl; // SSL connection
+    int connections = 0; // Pool size, 0 for sequential requests on one connection
+    const char *output = NULL; // Output file or prefix
+    char *default_path[] = { "/" };
+    char **paths;
+    int npaths;
+    int opt;
 
+    while ((opt = getopt(argc, argv, "c:o:")) != -1) {
+        switch (opt) {
+        case 'c':
+            connections = atoi(optarg);
+            if (connections < 1 || connections > MAX_CONNECTIONS) {
+                fprintf(stderr, "Connections must be between 1 and %d.\n", MAX_CONNECTIONS);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind < argc) {
+        paths = argv + optind;
+        npaths = argc - optind;
+    } else {
+        paths = default_path;
+        npaths = 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // A server closing a kept-alive connection must not kill the client
     init_openssl(); // Initialize OpenSSL
     ctx = create_context(); // Create SSL context
-    server_fd = open_connection(SERVER, PORT); // Open connection to the server
-    ssl = SSL_new(ctx); // Create a new SSL connection state
-    SSL_set_fd(ssl, server_fd); // Associate the connection with the file descriptor
 
-    printf("Starting SSL handshake...\n");
-    if (SSL_connect(ssl) != 1) { // Perform the SSL handshake
-        ERR_print_errors_fp(stderr);
-        SSL_free(ssl);
-        close(server_fd);
-        SSL_CTX_free(ctx);
-        cleanup_openssl();
+    struct request_stats *stats = calloc(npaths, sizeof(*stats));
+    if (!stats) {
+        perror("Unable to allocate request statistics");
         exit(EXIT_FAILURE);
     }
+    double wall_start = now_ms();
 
-    printf("SSL handshake completed.\n");
-    perform_request(ssl); // Perform the request
+    if (connections > 0) {
+        // Parallel mode: each pool thread owns one persistent connection
+        struct fetch_job job = { ctx, paths, npaths, output, stats, 0, PTHREAD_MUTEX_INITIALIZER };
+        pthread_t threads[MAX_CONNECTIONS];
+        if (connections > npaths) {
+            connections = npaths;
+        }
+        printf("Fetching %d path(s) over %d connection(s)...\n", npaths, connections);
+        for (int i = 0; i < connections; i++) {
+            if (pthread_create(&threads[i], NULL, fetch_worker, &job) != 0) {
+                perror("Unable to create thread");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (int i = 0; i < connections; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    } else {
+        // Sequential mode: stream each body to stdout or the output file over one connection
+        struct connection conn = { -1, NULL, 0 };
+        FILE *sink = stdout;
+        if (output) {
+            sink = fopen(output, "wb");
+            if (!sink) {
+                perror("Unable to open output file");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (int i = 0; i < npaths; i++) {
+            printf("Sending request for %s...\n", paths[i]);
+            fetch(ctx, &conn, paths[i], sink, &stats[i]);
+            if (sink == stdout) {
+                printf("\n");
+            }
+        }
+        if (sink != stdout) {
+            fclose(sink);
+        }
+        disconnect_ssl(&conn);
+    }
+
+    print_stats(stats, npaths, now_ms() - wall_start);
 
-    SSL_free(ssl); // Free the SSL structure
-    close(server_fd); // Close the socket
+    int failed = 0;
+    for (int i = 0; i < npaths; i++) {
+        failed |= (stats[i].status == 0);
+    }
+    free(stats);
     SSL_CTX_free(ctx); // Free the SSL context
     cleanup_openssl(); // Clean up OpenSSL
 
-    return 0;
+    return failed ? EXIT_FAILURE : 0;
 }
@@ -6,6 +6,22 @@
  * client connections, performs an SSL handshake, and responds to HTTP GET
  * requests with a simple text message.
  *
+ * The server can run several workers, either threads (-m thread) or
+ * pre-forked processes (-m process). Each worker owns its own SO_REUSEPORT
+ * listener and is pinned to a CPU, so the kernel spreads incoming connections
+ * and handshake crypto across cores. All workers share one SSL_CTX, the
+ * session ticket keys, and a session cache kept in shared memory. Workers
+ * record into the shared metrics module (../common/metrics.h), which the
+ * main thread/process aggregates, prints periodically and exports as a
+ * snapshot file or stats socket.
+ *
+ * With -e, each worker runs a non-blocking epoll event loop instead of
+ * serving one connection at a time. With -a, the event loop also puts the
+ * SSL connections in SSL_MODE_ASYNC and installs an RSA method that hands
+ * private-key operations to a crypto thread pool. SSL_accept() then pauses
+ * its ASYNC job while the RSA operation runs, and the event loop keeps
+ * servicing other connections until the pool signals completion.
+ *
  * Author(s): Kory Mayberry, Ashley Judson, Nathan Peckham
  * 
  * University of Colorado, Colorado Springs
@@ -17,19 +33,174 @@
  * - This program is part of an educational project to understand SSL/TLS operations.
  * - It is designed to handle simple HTTP GET requests and respond with a fixed message.
  * - This server is configured to listen on localhost on port 4433.
+ * - With -e or -a, connections are kept alive between requests until the
+ *   client closes them, asks for "Connection: close", or stays idle for
+ *   IDLE_TIMEOUT_SECS. Without them each worker serves one connection at a
+ *   time, so it answers a single request with "Connection: close" and an
+ *   idle client cannot hold the worker while new connections queue behind it.
  ***********************************************************************/
 
 
+#define _GNU_SOURCE // For CPU affinity, memmem and strcasestr
+#define OPENSSL_API_COMPAT 0x10100000L // The RSA_METHOD API used for crypto offload is deprecated in OpenSSL 3
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/rsa.h>
+#include <openssl/async.h>
+#include "../common/metrics.h"  // Shared counters and histograms
 
 #define PORT 4433  // Define the port number on which the server will listen
+#define MAX_WORKERS 64  // Upper bound on the number of worker threads or processes
+#define LISTEN_BACKLOG 1024  // Pending connections queued per worker listener
+#define IDLE_TIMEOUT_SECS 5  // Close connections idle for this long
+#define MAX_REQUEST_SIZE 4096  // Largest request head the server accepts
+#define STATS_INTERVAL_SECS 5  // How often the aggregated worker counters are printed
+#define SESSION_CACHE_SLOTS 1024  // Entries in the shared session cache
+#define SESSION_DER_MAX 1024  // Largest serialized session stored in the cache
+#define CIPHER_LIST "ECDHE-RSA-AES256-SHA384:ECDHE-ECDSA-AES256-SHA384:DHE-RSA-AES256-SHA256:ECDHE-ECDSA-AES256-SHA:ECDHE-RSA-AES256-SHA:DHE-RSA-AES256-SHA:AES256-SHA256:AES256-SHA"
+#define MAX_EVENTS 256  // Events handled per epoll_wait() call in the event loop
+#define REAP_INTERVAL_MS 1000  // How often the event loop looks for idle connections
+#define MAX_CRYPTO_THREADS 64  // Upper bound on the crypto offload thread pool
+
+#define RESPONSE_BODY "OpenSSL is fun! Hi Sully!"
+
+// The fixed response sent for every request on a kept-alive connection
+static const char response[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 25\r\n\r\n" RESPONSE_BODY;
+
+// The fixed response sent by blocking workers, which close the connection after one request
+static const char close_response[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 25\r\nConnection: close\r\n\r\n" RESPONSE_BODY;
+
+// One entry of the shared session cache
+struct session_slot {
+    unsigned int id_len;                          // 0 when the slot is empty
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+    unsigned int der_len;
+    unsigned char der[SESSION_DER_MAX];           // Serialized SSL_SESSION
+};
+
+// State shared by all workers, mapped before the workers are started so forked processes see it too
+struct shared_state {
+    pthread_mutex_t cache_lock;                   // Process-shared lock for the session cache
+    struct session_slot sessions[SESSION_CACHE_SLOTS];
+};
+
+struct shared_state *shared; // Mapped by create_shared_state()
+
+// Map the shared state as anonymous shared memory so it survives fork()
+void create_shared_state() {
+    pthread_mutexattr_t attr;
+
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("Unable to map shared state");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&shared->cache_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+// Pick the cache slot for a session ID (FNV-1a hash, direct mapped)
+struct session_slot *session_slot_for(const unsigned char *id, unsigned int len) {
+    unsigned int hash = 2166136261u;
+    for (unsigned int i = 0; i < len; i++) {
+        hash = (hash ^ id[i]) * 16777619u;
+    }
+    return &shared->sessions[hash % SESSION_CACHE_SLOTS];
+}
+
+// Called by OpenSSL when a new session is established; store it in the shared cache
+int new_session_cb(SSL *ssl, SSL_SESSION *sess) {
+    unsigned int id_len;
+    const unsigned char *id = SSL_SESSION_get_id(sess, &id_len);
+    int der_len = i2d_SSL_SESSION(sess, NULL);
+
+    if (id_len == 0 || der_len <= 0 || der_len > SESSION_DER_MAX) {
+        return 0; // Too large to share, the client will just do a full handshake next time
+    }
+
+    struct session_slot *slot = session_slot_for(id, id_len);
+    pthread_mutex_lock(&shared->cache_lock);
+    unsigned char *p = slot->der;
+    slot->der_len = i2d_SSL_SESSION(sess, &p);
+    memcpy(slot->id, id, id_len);
+    slot->id_len = id_len;
+    pthread_mutex_unlock(&shared->cache_lock);
+
+    return 0; // We did not keep a reference to sess
+}
+
+// Called by OpenSSL when a client offers a session ID; look it up in the shared cache
+SSL_SESSION *get_session_cb(SSL *ssl, const unsigned char *id, int id_len, int *copy) {
+    struct session_slot *slot = session_slot_for(id, id_len);
+    SSL_SESSION *sess = NULL;
+
+    *copy = 0; // The returned session is a fresh object owned by OpenSSL
+    pthread_mutex_lock(&shared->cache_lock);
+    if (slot->id_len == (unsigned int)id_len && memcmp(slot->id, id, id_len) == 0) {
+        const unsigned char *p = slot->der;
+        sess = d2i_SSL_SESSION(NULL, &p, slot->der_len);
+    }
+    pthread_mutex_unlock(&shared->cache_lock);
+
+    return sess;
+}
+
+// Called by OpenSSL when a session becomes invalid; drop it from the shared cache
+void remove_session_cb(SSL_CTX *ctx, SSL_SESSION *sess) {
+    unsigned int id_len;
+    const unsigned char *id = SSL_SESSION_get_id(sess, &id_len);
+    struct session_slot *slot = session_slot_for(id, id_len);
+
+    pthread_mutex_lock(&shared->cache_lock);
+    if (slot->id_len == id_len && memcmp(slot->id, id, id_len) == 0) {
+        slot->id_len = 0;
+    }
+    pthread_mutex_unlock(&shared->cache_lock);
+}
+
+// Share session state between workers: one set of ticket keys and the shared session cache
+void configure_session_sharing(SSL_CTX *ctx) {
+    unsigned char ticket_keys[80]; // 16-byte key name, 32-byte HMAC secret, 32-byte AES key
+
+    // Generate the ticket keys once, before the workers start, so every worker can decrypt every ticket
+    if (RAND_bytes(ticket_keys, sizeof(ticket_keys)) != 1 ||
+        SSL_CTX_set_tlsext_ticket_keys(ctx, ticket_keys, sizeof(ticket_keys)) != 1) {
+        ERR_print_errors_fp(stderr);
+        exit(EXIT_FAILURE);
+    }
+    OPENSSL_cleanse(ticket_keys, sizeof(ticket_keys));
+
+    // Use only the shared cache; OpenSSL's internal cache would be private to each forked worker
+    SSL_CTX_set_session_id_context(ctx, (const unsigned char *)"CS4220", 6);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_sess_set_new_cb(ctx, new_session_cb);
+    SSL_CTX_sess_set_get_cb(ctx, get_session_cb);
+    SSL_CTX_sess_set_remove_cb(ctx, remove_session_cb);
+}
 
 // Initialize OpenSSL libraries and load error strings
 void init_openssl() {
@@ -79,27 +250,197 @@ void configure_context(SSL_CTX *ctx) {
     }
 
     // Specify AES 256-bit cipher suites
-    const char *cipher_list = "ECDHE-RSA-AES256-SHA384:ECDHE-ECDSA-AES256-SHA384:DHE-RSA-AES256-SHA256:ECDHE-ECDSA-AES256-SHA:ECDHE-RSA-AES256-SHA:DHE-RSA-AES256-SHA:AES256-SHA256:AES256-SHA";
-    if (!SSL_CTX_set_cipher_list(ctx, cipher_list)) {
+    if (!SSL_CTX_set_cipher_list(ctx, CIPHER_LIST)) {
         fprintf(stderr, "Failed to set cipher list. Ensure the cipher suite is available in OpenSSL.\n");
         exit(EXIT_FAILURE);
     }
 
+    configure_session_sharing(ctx);
+
     printf("SSL context configured with certificate, private key, and AES 256-bit encryption.\n");
 }
 
-// Main function to set up the server socket and handle incoming connections
-int main(int argc, char **argv) {
-    int sockfd, new_sockfd;  // Socket file descriptors
-    SSL_CTX *ctx;
-    struct sockaddr_in addr;  // Socket address structure for IPv4
-    socklen_t len = sizeof(addr);  // Length of the address
-    SSL *ssl;
+// Signature shared by the RSA_METHOD private-key callbacks
+typedef int (*rsa_priv_fn)(int flen, const unsigned char *from, unsigned char *to, RSA *rsa, int padding);
 
-    // Initialize and configure OpenSSL
-    init_openssl();
-    ctx = create_context();
-    configure_context(ctx);
+// One private-key operation queued for the crypto thread pool
+struct crypto_op {
+    rsa_priv_fn fn;              // OpenSSL's software implementation to run
+    int flen;
+    const unsigned char *from;
+    unsigned char *to;
+    RSA *rsa;
+    int padding;
+    int result;                  // Return value of fn, valid once notify_fd is signalled
+    int notify_fd;               // eventfd the pool signals when the operation is done
+    struct crypto_op *next;
+};
+
+// Work queue shared by the crypto threads of one process
+struct crypto_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;        // Signalled when an operation is queued
+    struct crypto_op *head, *tail;
+    int depth;                   // Operations queued but not yet picked up
+};
+
+int crypto_threads = 0;  // Crypto threads per process, 0 when offload is disabled
+struct crypto_pool pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0 };
+pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+// Crypto thread: run queued private-key operations and wake the connection that asked for them
+void *crypto_thread_main(void *arg) {
+    uint64_t one = 1;
+
+    while (1) {
+        pthread_mutex_lock(&pool.lock);
+        while (!pool.head) {
+            pthread_cond_wait(&pool.ready, &pool.lock);
+        }
+        struct crypto_op *op = pool.head;
+        pool.head = op->next;
+        if (!pool.head) {
+            pool.tail = NULL;
+        }
+        pool.depth--;
+        pthread_mutex_unlock(&pool.lock);
+
+        op->result = op->fn(op->flen, op->from, op->to, op->rsa, op->padding);
+        // Read op->notify_fd before signalling; op lives on the paused job's stack and may vanish after
+        int fd = op->notify_fd;
+        if (write(fd, &one, sizeof(one)) != sizeof(one)) {
+            perror("Unable to signal crypto completion");
+        }
+    }
+    return NULL;
+}
+
+// Start the crypto threads; threads do not survive fork(), so each worker process calls this itself.
+// The caller is a pinned worker, so the threads get an explicit affinity of every online CPU instead of
+// inheriting the worker's single CPU.
+void start_crypto_pool() {
+    pthread_attr_t attr;
+    cpu_set_t all_cpus;
+    int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    CPU_ZERO(&all_cpus);
+    for (int cpu = 0; cpu < ncpus && cpu < CPU_SETSIZE; cpu++) {
+        CPU_SET(cpu, &all_cpus);
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setaffinity_np(&attr, sizeof(all_cpus), &all_cpus);
+
+    for (int i = 0; i < crypto_threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, crypto_thread_main, NULL) != 0) {
+            perror("Unable to create crypto thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_attr_destroy(&attr);
+    printf("Started %d crypto thread(s) on %d CPU(s).\n", crypto_threads, ncpus);
+}
+
+// ASYNC_WAIT_CTX cleanup callback: close the eventfd when the SSL connection is freed
+void close_wait_fd(ASYNC_WAIT_CTX *ctx, const void *key, OSSL_ASYNC_FD fd, void *custom_data) {
+    close(fd);
+}
+
+// Run fn on the crypto pool if we are inside an ASYNC job, pausing the job until it completes
+int offload_rsa(rsa_priv_fn fn, int flen, const unsigned char *from, unsigned char *to, RSA *rsa, int padding) {
+    ASYNC_JOB *job = ASYNC_get_current_job();
+    ASYNC_WAIT_CTX *waitctx;
+    OSSL_ASYNC_FD fd;
+    void *custom_data;
+    uint64_t value;
+
+    if (!job || crypto_threads == 0) {
+        return fn(flen, from, to, rsa, padding); // Not called from an async-capable SSL call
+    }
+
+    // Each connection gets one eventfd for its lifetime; the event loop polls it while the job is paused
+    waitctx = ASYNC_get_wait_ctx(job);
+    if (!ASYNC_WAIT_CTX_get_fd(waitctx, &pool, &fd, &custom_data)) {
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0 || !ASYNC_WAIT_CTX_set_wait_fd(waitctx, &pool, fd, NULL, close_wait_fd)) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            return fn(flen, from, to, rsa, padding);
+        }
+    }
+
+    struct crypto_op op = { fn, flen, from, to, rsa, padding, 0, fd, NULL };
+    pthread_mutex_lock(&pool.lock);
+    if (pool.tail) {
+        pool.tail->next = &op;
+    } else {
+        pool.head = &op;
+    }
+    pool.tail = &op;
+    int depth = ++pool.depth;
+    pthread_cond_signal(&pool.ready);
+    pthread_mutex_unlock(&pool.lock);
+    metrics_record(M_QUEUE_DEPTH, depth);
+
+    // The job may be resumed by unrelated socket events; only a signalled eventfd means the result is ready
+    while (read(fd, &value, sizeof(value)) != sizeof(value)) {
+        ASYNC_pause_job();
+    }
+    return op.result;
+}
+
+// RSA_METHOD callback for private-key encryption, which the handshake uses to sign the key exchange
+int async_rsa_priv_enc(int flen, const unsigned char *from, unsigned char *to, RSA *rsa, int padding) {
+    return offload_rsa(RSA_meth_get_priv_enc(RSA_PKCS1_OpenSSL()), flen, from, to, rsa, padding);
+}
+
+// Enable SSL_MODE_ASYNC and swap the server key for one whose private-key operations run on the crypto pool
+void configure_async_crypto(SSL_CTX *ctx) {
+    static RSA_METHOD *method;
+    EVP_PKEY *pkey;
+    RSA *rsa;
+
+    if (!ASYNC_is_capable()) {
+        fprintf(stderr, "OpenSSL ASYNC jobs are not supported on this platform.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Stand-in for an async crypto engine: OpenSSL's own RSA code, run on our thread pool
+    method = RSA_meth_dup(RSA_PKCS1_OpenSSL());
+    RSA_meth_set1_name(method, "CS4220 async RSA offload");
+    RSA_meth_set_priv_enc(method, async_rsa_priv_enc);
+
+    // A key with a custom RSA_METHOD is kept on OpenSSL's legacy path, which calls the method directly
+    rsa = EVP_PKEY_get1_RSA(SSL_CTX_get0_privatekey(ctx));
+    if (!rsa) {
+        fprintf(stderr, "Async crypto offload requires an RSA server key.\n");
+        exit(EXIT_FAILURE);
+    }
+    RSA_set_method(rsa, method);
+    pkey = EVP_PKEY_new();
+    if (!pkey || !EVP_PKEY_assign_RSA(pkey, rsa) || SSL_CTX_use_PrivateKey(ctx, pkey) <= 0) {
+        ERR_print_errors_fp(stderr);
+        exit(EXIT_FAILURE);
+    }
+    EVP_PKEY_free(pkey); // The context holds its own reference
+
+    // Plain RSA key exchange needs a padding mode only the provider path implements, so keep (EC)DHE only
+    if (!SSL_CTX_set_cipher_list(ctx, CIPHER_LIST ":!kRSA")) {
+        ERR_print_errors_fp(stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    SSL_CTX_set_mode(ctx, SSL_MODE_ASYNC);
+    printf("SSL context configured for asynchronous RSA offload.\n");
+}
+
+// Create a listening socket bound to PORT; SO_REUSEPORT lets every worker bind its own
+int open_listener() {
+    int sockfd;
+    int on = 1;
+    struct sockaddr_in addr;  // Socket address structure for IPv4
 
     // Create a new socket
     sockfd = socket(AF_INET, SOCK_STREAM, 0);
@@ -108,6 +449,12 @@ int main(int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+        setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        perror("Unable to set SO_REUSEPORT");
+        exit(EXIT_FAILURE);
+    }
+
     // Set up the socket address structure
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
@@ -121,46 +468,516 @@ int main(int argc, char **argv) {
     }
 
     // Listen on the socket for incoming connections
-    if (listen(sockfd, 1) < 0) {
+    if (listen(sockfd, LISTEN_BACKLOG) < 0) {
         perror("Unable to listen");
         exit(EXIT_FAILURE);
     }
 
-    printf("Server is up and listening on port %d.\n", PORT);
+    return sockfd;
+}
+
+// Consume one complete request head from buf; returns 1 to keep the connection open, 0 to close it,
+// or -1 if the head is not complete yet
+int parse_request(char *buf, int *buffered) {
+    char *end = memmem(buf, *buffered, "\r\n\r\n", 4);
+    if (!end) {
+        return *buffered == MAX_REQUEST_SIZE ? 0 : -1; // A full buffer without a head is too large
+    }
+
+    int head_len = end + 4 - buf;
+    end[2] = '\0';
+    int keep_alive = strncmp(buf, "GET ", 4) == 0 && !strcasestr(buf, "\r\nConnection: close");
+    // Keep any pipelined bytes that follow this request
+    memmove(buf, buf + head_len, *buffered - head_len);
+    *buffered -= head_len;
+    return keep_alive;
+}
+
+// Read one request head (up to the blank line); returns 1 to keep the connection open, 0 to close it
+int read_request(SSL *ssl, char *buf, int *buffered) {
+    while (1) {
+        int keep_alive = parse_request(buf, buffered);
+        if (keep_alive >= 0) {
+            return keep_alive;
+        }
+
+        int n = SSL_read(ssl, buf + *buffered, MAX_REQUEST_SIZE - *buffered);
+        if (n <= 0) {
+            return -1; // Client closed the connection, timed out, or failed
+        }
+        metrics_add(M_BYTES_RECEIVED, n);
+        *buffered += n;
+    }
+}
+
+// Record a completed handshake that started at start_us
+void record_handshake(SSL *ssl, uint64_t start_us) {
+    metrics_add(M_HANDSHAKES, 1);
+    metrics_record(M_HANDSHAKE_US, metrics_now_us() - start_us);
+    if (SSL_session_reused(ssl)) {
+        metrics_add(M_SESSIONS_RESUMED, 1);
+    }
+}
+
+// Record a response of len bytes sent on a connection accepted at accepted_us; the first one gives the
+// time to first byte
+void record_response(uint64_t accepted_us, int previous_responses, size_t len) {
+    metrics_add(M_REQUESTS, 1);
+    metrics_add(M_BYTES_SENT, len);
+    if (previous_responses == 0) {
+        metrics_record(M_TTFB_US, metrics_now_us() - accepted_us);
+    }
+}
+
+// Perform the handshake and answer one request on an accepted connection
+void handle_connection(SSL_CTX *ctx, int fd) {
+    char request[MAX_REQUEST_SIZE];
+    int buffered = 0;
+    struct timeval timeout = { IDLE_TIMEOUT_SECS, 0 };
+    SSL *ssl;
+
+    // Do not let an idle client hold the worker forever
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Create a new SSL structure for the connection
+    ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+
+    // Perform the SSL handshake
+    uint64_t start = metrics_now_us();
+    if (SSL_accept(ssl) <= 0) {
+        ERR_print_errors_fp(stderr);
+        PACKET_LOG("SSL handshake failed.\n");
+        metrics_add(M_HANDSHAKE_FAILURES, 1);
+    } else {
+        record_handshake(ssl, start);
+        PACKET_LOG("SSL handshake succeeded.\n");
+
+        // Answer one request and close; keeping the connection alive would block this worker while it is idle
+        if (read_request(ssl, request, &buffered) >= 0 &&
+            SSL_write(ssl, close_response, sizeof(close_response) - 1) > 0) {
+            record_response(start, 0, sizeof(close_response) - 1);
+            PACKET_LOG("Response sent to client.\n");
+        }
+    }
+
+    // Shutdown the SSL connection, free the SSL structure, and close the socket
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+    PACKET_LOG("Connection closed.\n");
+}
+
+// Where a connection served by the event loop is in its lifetime
+enum conn_state { CONN_HANDSHAKE, CONN_READING, CONN_WRITING, CONN_CLOSED };
+
+// A non-blocking connection served by the event loop
+struct conn {
+    int fd;
+    SSL *ssl;
+    enum conn_state state;
+    int keep_alive;                   // Keep the connection open after the current response
+    uint64_t accepted_us;             // Accept time, for the handshake duration and time to first byte
+    uint64_t last_active_us;          // Last time the connection made progress, for the idle timeout
+    int responses;                    // Responses sent so far
+    char request[MAX_REQUEST_SIZE];
+    int buffered;
+    struct conn *next_closed;         // Link in the list of connections to free after this batch
+    struct conn *prev, *next;         // Links in the worker's list of open connections
+};
+
+// Watch the fds of any paused ASYNC jobs; they become readable when the crypto pool finishes
+void watch_async_fds(int epfd, struct conn *c) {
+    OSSL_ASYNC_FD fds[4];
+    size_t nfds = 0;
+
+    if (!SSL_get_all_async_fds(c->ssl, NULL, &nfds) || nfds > 4 || !SSL_get_all_async_fds(c->ssl, fds, &nfds)) {
+        return;
+    }
+    for (size_t i = 0; i < nfds; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev) < 0 && errno != EEXIST) {
+            perror("Unable to watch async fd");
+        }
+    }
+}
+
+// Drive a connection as far as it can go without blocking
+void conn_progress(int epfd, struct conn *c) {
+    int rc;
+
+    c->last_active_us = metrics_now_us();
+    while (c->state != CONN_CLOSED) {
+        switch (c->state) {
+        case CONN_HANDSHAKE:
+            rc = SSL_do_handshake(c->ssl);
+            if (rc == 1) {
+                record_handshake(c->ssl, c->accepted_us);
+                c->state = CONN_READING;
+                continue;
+            }
+            break;
+
+        case CONN_READING:
+            c->keep_alive = parse_request(c->request, &c->buffered);
+            if (c->keep_alive >= 0) {
+                c->state = CONN_WRITING;
+                continue;
+            }
+            rc = SSL_read(c->ssl, c->request + c->buffered, MAX_REQUEST_SIZE - c->buffered);
+            if (rc > 0) {
+                metrics_add(M_BYTES_RECEIVED, rc);
+                c->buffered += rc;
+                continue;
+            }
+            break;
+
+        case CONN_WRITING:
+            // A retried SSL_write must repeat the same arguments, which the fixed response guarantees
+            rc = SSL_write(c->ssl, response, sizeof(response) - 1);
+            if (rc > 0) {
+                record_response(c->accepted_us, c->responses++, sizeof(response) - 1);
+                c->state = c->keep_alive ? CONN_READING : CONN_CLOSED;
+                continue;
+            }
+            break;
+
+        default:
+            return;
+        }
+
+        switch (SSL_get_error(c->ssl, rc)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            return; // Edge-triggered socket events will call us again
+        case SSL_ERROR_WANT_ASYNC:
+            watch_async_fds(epfd, c);
+            return; // The crypto pool will wake us through the async fd
+        default:
+            if (c->state == CONN_HANDSHAKE) {
+                ERR_print_errors_fp(stderr);
+                metrics_add(M_HANDSHAKE_FAILURES, 1);
+            }
+            ERR_clear_error();
+            c->state = CONN_CLOSED;
+        }
+    }
+}
+
+// Event loop worker: accept and serve every connection of this worker without blocking
+void run_event_loop(SSL_CTX *ctx, int sockfd) {
+    struct epoll_event events[MAX_EVENTS];
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL }; // NULL marks the listener
+
+    if (crypto_threads > 0) {
+        pthread_once(&pool_once, start_crypto_pool);
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("Unable to create epoll instance");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        perror("Unable to watch listener");
+        exit(EXIT_FAILURE);
+    }
+
+    struct conn *open_conns = NULL; // Every connection not yet freed, for the idle timeout
+    uint64_t last_reap_us = metrics_now_us();
+
+    while (1) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, REAP_INTERVAL_MS);
+        if (n < 0) {
+            if (errno != EINTR) {
+                perror("epoll_wait failed");
+            }
+            n = 0;
+        }
+
+        // Connections closed in this batch are freed at the end, since later events may still point at them
+        struct conn *closed = NULL;
+
+        for (int i = 0; i < n; i++) {
+            struct conn *c = events[i].data.ptr;
+
+            if (!c) {
+                // Accept everything pending on the listener
+                int new_sockfd;
+                while ((new_sockfd = accept4(sockfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    metrics_add(M_CONNECTIONS, 1);
+                    c = calloc(1, sizeof(*c));
+                    if (!c) {
+                        close(new_sockfd);
+                        continue;
+                    }
+                    c->fd = new_sockfd;
+                    c->ssl = SSL_new(ctx);
+                    c->state = CONN_HANDSHAKE;
+                    c->accepted_us = metrics_now_us();
+                    SSL_set_fd(c->ssl, new_sockfd);
+                    SSL_set_accept_state(c->ssl);
+                    c->next = open_conns;
+                    if (open_conns) {
+                        open_conns->prev = c;
+                    }
+                    open_conns = c;
+
+                    struct epoll_event cev = { .events = EPOLLIN | EPOLLOUT | EPOLLET, .data.ptr = c };
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, new_sockfd, &cev);
+                    conn_progress(epfd, c);
+                    if (c->state == CONN_CLOSED) {
+                        c->next_closed = closed;
+                        closed = c;
+                    }
+                }
+                continue;
+            }
+
+            if (c->state == CONN_CLOSED) {
+                continue; // Already queued for freeing
+            }
+            conn_progress(epfd, c);
+            if (c->state == CONN_CLOSED) {
+                c->next_closed = closed;
+                closed = c;
+            }
+        }
+
+        // Close connections idle for IDLE_TIMEOUT_SECS, which blocking mode gets from SO_RCVTIMEO. A paused
+        // ASYNC job is skipped: its crypto thread still points at the connection's crypto_op.
+        uint64_t now = metrics_now_us();
+        if (now - last_reap_us >= REAP_INTERVAL_MS * 1000ULL) {
+            last_reap_us = now;
+            for (struct conn *c = open_conns; c; c = c->next) {
+                if (c->state != CONN_CLOSED && now - c->last_active_us >= IDLE_TIMEOUT_SECS * 1000000ULL &&
+                    !SSL_waiting_for_async(c->ssl)) {
+                    PACKET_LOG("Closing idle connection.\n");
+                    c->state = CONN_CLOSED;
+                    c->next_closed = closed;
+                    closed = c;
+                }
+            }
+        }
+
+        while (closed) {
+            struct conn *c = closed;
+            closed = c->next_closed;
+            if (c->prev) {
+                c->prev->next = c->next;
+            } else {
+                open_conns = c->next;
+            }
+            if (c->next) {
+                c->next->prev = c->prev;
+            }
+            SSL_shutdown(c->ssl);
+            SSL_free(c->ssl); // Also closes the connection's async eventfd, removing it from epoll
+            close(c->fd);
+            free(c);
+        }
+    }
+}
+
+// Pin the calling thread to one CPU
+void pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        fprintf(stderr, "Unable to pin worker to CPU %d: %s\n", cpu, strerror(err));
+    }
+}
+
+// Settings handed to each worker
+struct worker {
+    int id;        // Worker number, for log messages
+    int cpu;       // CPU to pin to, -1 for no pinning
+    SSL_CTX *ctx;  // Shared SSL context
+    int event_loop; // 1 to serve connections from a non-blocking epoll loop
+    pthread_t thread;
+};
+
+// Worker loop: accept connections on a private SO_REUSEPORT listener and serve them
+void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct sockaddr_in addr;
+    socklen_t len;
+
+    if (w->cpu >= 0) {
+        pin_to_cpu(w->cpu);
+    }
+    int sockfd = open_listener();
+    printf("Worker %d listening on port %d (CPU %d).\n", w->id, PORT, w->cpu);
+
+    if (w->event_loop) {
+        run_event_loop(w->ctx, sockfd);
+        close(sockfd);
+        return NULL;
+    }
 
     // Accept incoming connections in a loop
     while (1) {
-        new_sockfd = accept(sockfd, (struct sockaddr*)&addr, &len);
+        len = sizeof(addr);
+        int new_sockfd = accept(sockfd, (struct sockaddr*)&addr, &len);
         if (new_sockfd < 0) {
             perror("Unable to accept");
             continue;
         }
 
-        printf("Connection accepted from %s:%d.\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+        metrics_add(M_CONNECTIONS, 1);
+        PACKET_LOG("Connection accepted from %s:%d.\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+        handle_connection(w->ctx, new_sockfd);
+    }
 
-        // Create a new SSL structure for the connection
-        ssl = SSL_new(ctx);
-        SSL_set_fd(ssl, new_sockfd);
+    close(sockfd);
+    return NULL;
+}
 
-        // Perform the SSL handshake
-        if (SSL_accept(ssl) <= 0) {
-            ERR_print_errors_fp(stderr);
-            printf("SSL handshake failed.\n");
-        } else {
-            printf("SSL handshake succeeded.\n");
-            SSL_write(ssl, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\nOpenSSL is fun! Hi Sully!", strlen("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\nOpenSSL is fun! Hi Sully!"));
-            printf("Response sent to client.\n");
+// Print the counters aggregated over all workers along with the handshake rate since the last report
+void print_stats(uint64_t *last_handshakes, double elapsed) {
+    uint64_t handshakes = metrics_counter_total(M_HANDSHAKES);
+
+    fprintf(stderr, "[stats] connections %llu, handshakes %llu (%.1f/s, %llu resumed, %llu failed), "
+            "requests %llu, bytes sent %llu\n",
+            (unsigned long long)metrics_counter_total(M_CONNECTIONS), (unsigned long long)handshakes,
+            (handshakes - *last_handshakes) / elapsed,
+            (unsigned long long)metrics_counter_total(M_SESSIONS_RESUMED),
+            (unsigned long long)metrics_counter_total(M_HANDSHAKE_FAILURES),
+            (unsigned long long)metrics_counter_total(M_REQUESTS),
+            (unsigned long long)metrics_counter_total(M_BYTES_SENT));
+    *last_handshakes = handshakes;
+}
+
+// Print command line usage
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-w workers] [-m thread|process] [-n] [-e] [-a] [-t crypto_threads]\n", prog);
+    fprintf(stderr, "  -w N      number of workers, defaults to the number of online CPUs\n");
+    fprintf(stderr, "  -m MODE   run workers as threads (default) or pre-forked processes\n");
+    fprintf(stderr, "  -n        do not pin workers to CPUs\n");
+    fprintf(stderr, "  -e        serve connections from a non-blocking epoll event loop\n");
+    fprintf(stderr, "  -a        offload RSA private-key operations to crypto threads (implies -e)\n");
+    fprintf(stderr, "  -t N      crypto threads per process (implies -a), defaults to the number of online CPUs\n");
+    exit(EXIT_FAILURE);
+}
+
+// Main function to set up the shared SSL context, start the workers, and report their counters
+int main(int argc, char **argv) {
+    SSL_CTX *ctx;
+    int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int nworkers = ncpus;
+    int use_processes = 0;
+    int pin = 1;
+    int event_loop = 0;
+    int async_crypto = 0;
+    int ncrypto = ncpus;
+    struct worker workers[MAX_WORKERS];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:m:neat:")) != -1) {
+        switch (opt) {
+        case 'w':
+            nworkers = atoi(optarg);
+            break;
+        case 'm':
+            if (strcmp(optarg, "process") == 0) {
+                use_processes = 1;
+            } else if (strcmp(optarg, "thread") != 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'n':
+            pin = 0;
+            break;
+        case 'e':
+            event_loop = 1;
+            break;
+        case 'a':
+            async_crypto = 1;
+            event_loop = 1;
+            break;
+        case 't':
+            ncrypto = atoi(optarg);
+            if (ncrypto < 1 || ncrypto > MAX_CRYPTO_THREADS) {
+                fprintf(stderr, "Crypto threads must be between 1 and %d.\n", MAX_CRYPTO_THREADS);
+                exit(EXIT_FAILURE);
+            }
+            async_crypto = 1; // A crypto thread count only makes sense with offload
+            event_loop = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (nworkers < 1 || nworkers > MAX_WORKERS) {
+        fprintf(stderr, "Workers must be between 1 and %d.\n", MAX_WORKERS);
+        exit(EXIT_FAILURE);
+    }
+
+    signal(SIGPIPE, SIG_IGN); // A client disconnecting mid-write must not kill the worker
+
+    // Initialize and configure OpenSSL once; every worker shares this context
+    create_shared_state();
+    metrics_init("http_server"); // Before forking, so worker processes report into the same slots
+    init_openssl();
+    ctx = create_context();
+    configure_context(ctx);
+    if (async_crypto) {
+        configure_async_crypto(ctx);
+        crypto_threads = ncrypto;
+    }
+
+    printf("Server starting %d %s worker(s) on port %d%s.\n", nworkers, use_processes ? "process" : "thread", PORT,
+           async_crypto ? " with async crypto offload" : event_loop ? " with event loops" : "");
+
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].id = i;
+        workers[i].cpu = pin ? i % ncpus : -1;
+        workers[i].ctx = ctx;
+        workers[i].event_loop = event_loop;
+
+        if (use_processes) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("Unable to fork worker");
+                exit(EXIT_FAILURE);
+            }
+            if (pid == 0) {
+                worker_main(&workers[i]); // Never returns
+                exit(EXIT_SUCCESS);
+            }
+        } else if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            perror("Unable to create worker thread");
+            exit(EXIT_FAILURE);
         }
+    }
+
+    // Export snapshots from this thread/process only; forked workers do not inherit the exporter thread
+    metrics_start_exporter();
 
-        // Shutdown the SSL connection, free the SSL structure, and close the socket
-        SSL_shutdown(ssl);
-        SSL_free(ssl);
-        close(new_sockfd);
-        printf("Connection closed.\n");
+    // Aggregate and print the worker counters until interrupted
+#ifdef NO_METRICS
+    fprintf(stderr, "Built with NO_METRICS, periodic stats are disabled.\n");
+#else
+    uint64_t last_handshakes = 0;
+#endif
+    while (1) {
+        sleep(STATS_INTERVAL_SECS);
+        if (use_processes) {
+            int status;
+            pid_t pid;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                fprintf(stderr, "Worker process %d exited with status %d.\n", pid, status);
+            }
+        }
+#ifndef NO_METRICS
+        print_stats(&last_handshakes, STATS_INTERVAL_SECS);
+#endif
     }
 
     // Cleanup operations
-    close(sockfd);
     SSL_CTX_free(ctx);
     cleanup_openssl();
 
@@ -0,0 +1,410 @@
+/***********************************************************************
+ * transport_bench.c
+ *
+ * Runs the same workload over every transport in ../common/transport.h on
+ * loopback and prints one comparison table, so a transport can be chosen
+ * per workload from measured data.
+ *
+ * For each transport a server process is forked and the client then:
+ * 1. sends a header describing the run,
+ * 2. exchanges -n small messages of -m bytes with the server, one at a
+ *    time, timing each round trip (latency percentiles),
+ * 3. sends the file (-f) or a generated payload of -s MB in chunks of the
+ *    configured buffer size, and waits for the server to confirm the byte
+ *    count and checksum (throughput).
+ * CPU time is taken from getrusage() for the client and wait4() for the
+ * server process.
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ *
+ *
+ * Notes:
+ * - Listener, port, buffer size, rudp window/timeout/loss and TLS
+ *   certificate come from transport_config_init() and the options below.
+ ***********************************************************************/
+#define _DEFAULT_SOURCE // For htobe64 and wait4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <endian.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "../common/transport.h"
+#include "../common/metrics.h"
+
+#define DEFAULT_TRANSPORTS "tcp,rudp,tls"
+#define DEFAULT_SIZE_MB 32  // Generated payload size
+#define DEFAULT_PINGS 2000  // Round trips in the latency phase
+#define DEFAULT_MESSAGE_SIZE 64  // Bytes per latency message
+#define MAX_MESSAGE_SIZE 65536
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL  // 64-bit FNV-1a parameters
+#define FNV_PRIME 0x100000001b3ULL
+
+// Sent by the client before the workload; all fields in network byte order
+struct bench_header {
+    uint64_t pings;         // Round trips in the latency phase
+    uint64_t message_size;  // Bytes per latency message
+    uint64_t payload_size;  // Bytes in the transfer phase
+};
+
+// Sent by the server after the transfer phase
+struct bench_ack {
+    uint64_t received;      // Payload bytes received
+    uint64_t checksum;      // FNV-1a hash of the payload stream
+};
+
+// Measurements for one transport
+struct bench_result {
+    const char *name;
+    int ok;
+    double transfer_secs;
+    double wall_secs;
+    double mb_per_sec;
+    double p50, p90, p99, p999, max;  // Round trip latency in microseconds
+    double client_cpu, server_cpu;    // CPU seconds
+    uint64_t retransmits;
+};
+
+// Continue a 64-bit FNV-1a hash over buf; start from FNV_OFFSET_BASIS. Unlike a plain byte sum it
+// changes when bytes are reordered, dropped or duplicated, so out-of-order delivery fails the check
+uint64_t checksum(uint64_t hash, const unsigned char *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ buf[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// CPU seconds (user + system) in a struct rusage
+double cpu_secs(const struct rusage *ru) {
+    return ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6 + ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+}
+
+// Server side of the workload, run in the forked child; returns the exit status
+int run_server(struct transport_conn *listener, size_t buffer_size) {
+    struct bench_header header;
+    struct bench_ack ack;
+    struct transport_conn *conn = listener->ops->accept(listener);
+    if (!conn) {
+        return EXIT_FAILURE;
+    }
+
+    if (transport_recv_all(conn, &header, sizeof(header)) != sizeof(header)) {
+        fprintf(stderr, "Server: missing header.\n");
+        return EXIT_FAILURE;
+    }
+    uint64_t pings = be64toh(header.pings);
+    size_t message_size = be64toh(header.message_size);
+    uint64_t payload_size = be64toh(header.payload_size);
+    if (message_size == 0 || message_size > MAX_MESSAGE_SIZE) {
+        fprintf(stderr, "Server: bad message size.\n");
+        return EXIT_FAILURE;
+    }
+
+    unsigned char *buf = malloc(buffer_size > message_size ? buffer_size : message_size);
+    if (!buf) {
+        perror("Server: unable to allocate buffer");
+        return EXIT_FAILURE;
+    }
+
+    // Latency phase: echo every message
+    for (uint64_t i = 0; i < pings; i++) {
+        if (transport_recv_all(conn, buf, message_size) != (ssize_t)message_size ||
+            transport_send(conn, buf, message_size) < 0) {
+            fprintf(stderr, "Server: echo %llu failed.\n", (unsigned long long)i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Transfer phase: drain the payload, then report what arrived
+    uint64_t received = 0, hash = FNV_OFFSET_BASIS;
+    while (received < payload_size) {
+        size_t want = payload_size - received < buffer_size ? payload_size - received : buffer_size;
+        ssize_t n = transport_recv(conn, buf, want);
+        if (n <= 0) {
+            fprintf(stderr, "Server: transfer ended after %llu bytes.\n", (unsigned long long)received);
+            return EXIT_FAILURE;
+        }
+        hash = checksum(hash, buf, n);
+        received += n;
+    }
+    ack.received = htobe64(received);
+    ack.checksum = htobe64(hash);
+    if (transport_send(conn, &ack, sizeof(ack)) < 0) {
+        fprintf(stderr, "Server: unable to acknowledge the transfer.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Wait for the client to close so its last packets are acknowledged
+    while (transport_recv(conn, buf, buffer_size) > 0) {
+    }
+    transport_close(conn);
+    free(buf);
+    return EXIT_SUCCESS;
+}
+
+// Compare two doubles for qsort
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Run the workload over one transport and fill in the result
+void run_transport(const struct transport_ops *ops, const struct transport_config *cfg,
+                   const unsigned char *payload, size_t payload_size, int pings, size_t message_size,
+                   struct bench_result *r) {
+    struct rusage before, after, server_usage;
+    struct bench_header header;
+    struct bench_ack ack;
+    int status;
+
+    memset(r, 0, sizeof(*r));
+    r->name = ops->name;
+    uint64_t retransmits_before = metrics_counter_total(M_RETRANSMITS);
+
+    // Listen before forking so the client cannot connect too early
+    struct transport_conn *listener = ops->listen(cfg);
+    if (!listener) {
+        return;
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Unable to fork server");
+        transport_close(listener);
+        return;
+    }
+    if (pid == 0) {
+        exit(run_server(listener, cfg->buffer_size));
+    }
+    transport_close(listener);
+
+    getrusage(RUSAGE_SELF, &before);
+    uint64_t wall_start = metrics_now_us();
+    double *rtt = malloc(pings * sizeof(double));
+    unsigned char *message = calloc(1, message_size);
+    struct transport_conn *conn = ops->connect(cfg);
+    if (!conn || !rtt || !message) {
+        goto done;
+    }
+
+    header.pings = htobe64(pings);
+    header.message_size = htobe64(message_size);
+    header.payload_size = htobe64(payload_size);
+    if (transport_send(conn, &header, sizeof(header)) < 0) {
+        goto done;
+    }
+
+    // Latency phase
+    for (int i = 0; i < pings; i++) {
+        uint64_t start = metrics_now_us();
+        if (transport_send(conn, message, message_size) < 0 ||
+            transport_recv_all(conn, message, message_size) != (ssize_t)message_size) {
+            fprintf(stderr, "%s: round trip %d failed.\n", ops->name, i);
+            goto done;
+        }
+        rtt[i] = metrics_now_us() - start;
+    }
+
+    // Transfer phase
+    uint64_t transfer_start = metrics_now_us();
+    for (size_t sent = 0; sent < payload_size; ) {
+        size_t chunk = payload_size - sent < cfg->buffer_size ? payload_size - sent : cfg->buffer_size;
+        if (transport_send(conn, payload + sent, chunk) < 0) {
+            fprintf(stderr, "%s: transfer failed after %zu bytes.\n", ops->name, sent);
+            goto done;
+        }
+        sent += chunk;
+    }
+    if (transport_recv_all(conn, &ack, sizeof(ack)) != sizeof(ack)) {
+        fprintf(stderr, "%s: no transfer acknowledgement.\n", ops->name);
+        goto done;
+    }
+    r->transfer_secs = (metrics_now_us() - transfer_start) / 1e6;
+    if (be64toh(ack.received) != payload_size || be64toh(ack.checksum) != checksum(FNV_OFFSET_BASIS, payload, payload_size)) {
+        fprintf(stderr, "%s: payload corrupted in transit.\n", ops->name);
+        goto done;
+    }
+    r->ok = 1;
+
+done:
+    if (conn) {
+        transport_close(conn);
+    }
+    if (!r->ok) {
+        kill(pid, SIGKILL); // The server may be stuck waiting for the rest of the workload
+    }
+    wait4(pid, &status, 0, &server_usage);
+    getrusage(RUSAGE_SELF, &after);
+    r->wall_secs = (metrics_now_us() - wall_start) / 1e6;
+    r->client_cpu = cpu_secs(&after) - cpu_secs(&before);
+    r->server_cpu = cpu_secs(&server_usage);
+    r->retransmits = metrics_counter_total(M_RETRANSMITS) - retransmits_before;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        r->ok = 0;
+    }
+
+    if (r->ok) {
+        qsort(rtt, pings, sizeof(double), compare_double);
+        r->mb_per_sec = payload_size / 1048576.0 / r->transfer_secs;
+        if (pings > 0) {
+            r->p50 = rtt[(int)(pings * 0.50)];
+            r->p90 = rtt[(int)(pings * 0.90)];
+            r->p99 = rtt[(int)(pings * 0.99)];
+            r->p999 = rtt[(int)(pings * 0.999)];
+            r->max = rtt[pings - 1];
+        }
+    }
+    free(rtt);
+    free(message);
+}
+
+// Read the whole file into memory; returns NULL on failure
+unsigned char *read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror("Unable to open payload file");
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char *buf = malloc(len > 0 ? len : 1);
+    if (!buf || fread(buf, 1, len, file) != (size_t)len) {
+        perror("Unable to read payload file");
+        free(buf);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    *size = len;
+    return buf;
+}
+
+// Print command line usage
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-t transports] [-f file | -s MB] [-n pings] [-m bytes] [-b bytes]\n"
+                    "       [-p port] [-w window] [-T timeout_ms] [-l loss]\n", prog);
+    fprintf(stderr, "  -t LIST   comma separated transports to run (default %s, available %s)\n",
+            DEFAULT_TRANSPORTS, transport_names());
+    fprintf(stderr, "  -f FILE   transfer this file instead of a generated payload\n");
+    fprintf(stderr, "  -s MB     size of the generated payload (default %d)\n", DEFAULT_SIZE_MB);
+    fprintf(stderr, "  -n N      round trips in the latency phase (default %d)\n", DEFAULT_PINGS);
+    fprintf(stderr, "  -m BYTES  size of each latency message (default %d)\n", DEFAULT_MESSAGE_SIZE);
+    fprintf(stderr, "  -b BYTES  send/receive chunk size (default %d)\n", TRANSPORT_DEFAULT_BUFFER_SIZE);
+    fprintf(stderr, "  -p PORT   port for every transport (default %d)\n", TRANSPORT_DEFAULT_PORT);
+    fprintf(stderr, "  -w N      rudp window in packets (default %d)\n", TRANSPORT_DEFAULT_WINDOW);
+    fprintf(stderr, "  -T MS     rudp retransmission timeout (default %d)\n", TRANSPORT_DEFAULT_TIMEOUT_MS);
+    fprintf(stderr, "  -l RATE   rudp simulated loss rate, 0 to 0.99 (default 0)\n");
+    exit(EXIT_FAILURE);
+}
+
+// Main function to run the workload over each transport and print the comparison
+int main(int argc, char **argv) {
+    struct transport_config cfg;
+    char transports[256] = DEFAULT_TRANSPORTS;
+    const char *file = NULL;
+    size_t payload_size = (size_t)DEFAULT_SIZE_MB * 1048576;
+    int pings = DEFAULT_PINGS;
+    size_t message_size = DEFAULT_MESSAGE_SIZE;
+    int opt;
+
+    transport_config_init(&cfg);
+    while ((opt = getopt(argc, argv, "t:f:s:n:m:b:p:w:T:l:")) != -1) {
+        switch (opt) {
+        case 't':
+            snprintf(transports, sizeof(transports), "%s", optarg);
+            break;
+        case 'f':
+            file = optarg;
+            break;
+        case 's':
+            payload_size = (size_t)(atof(optarg) * 1048576);
+            break;
+        case 'n':
+            pings = atoi(optarg);
+            break;
+        case 'm':
+            message_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            cfg.buffer_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            cfg.port = atoi(optarg);
+            break;
+        case 'w':
+            cfg.window_size = atoi(optarg);
+            break;
+        case 'T':
+            cfg.timeout_ms = atoi(optarg);
+            break;
+        case 'l':
+            cfg.loss_rate = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (pings < 0 || message_size == 0 || message_size > MAX_MESSAGE_SIZE || cfg.buffer_size == 0 ||
+        cfg.loss_rate < 0 || cfg.loss_rate > 0.99) {
+        usage(argv[0]);
+    }
+
+    unsigned char *payload;
+    if (file) {
+        payload = read_file(file, &payload_size);
+    } else {
+        payload = malloc(payload_size ? payload_size : 1);
+        if (payload) {
+            for (size_t i = 0; i < payload_size; i++) {
+                payload[i] = (unsigned char)(i * 31 + (i >> 12)); // Not all zeros, so the checksum means something
+            }
+        }
+    }
+    if (!payload) {
+        exit(EXIT_FAILURE);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    metrics_init("transport_bench"); // Shared with the forked servers, so their retransmits count too
+
+    printf("Payload %.1f MB%s%s, %d round trips of %zu bytes, %zu-byte chunks, port %d\n\n",
+           payload_size / 1048576.0, file ? " from " : "", file ? file : "", pings, message_size,
+           cfg.buffer_size, cfg.port);
+    printf("%-9s %9s %9s %9s %9s %9s %9s %12s %12s %11s\n", "transport", "MB/s", "p50(us)", "p90(us)",
+           "p99(us)", "p99.9(us)", "max(us)", "client_cpu", "server_cpu", "retransmits");
+
+    int failed = 0;
+    for (char *name = strtok(transports, ","); name; name = strtok(NULL, ",")) {
+        const struct transport_ops *ops = transport_find(name);
+        struct bench_result r;
+        if (!ops) {
+            fprintf(stderr, "Unknown transport %s (available: %s).\n", name, transport_names());
+            failed = 1;
+            continue;
+        }
+
+        run_transport(ops, &cfg, payload, payload_size, pings, message_size, &r);
+        if (!r.ok) {
+            printf("%-9s failed\n", r.name);
+            failed = 1;
+            continue;
+        }
+        printf("%-9s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %6.2fs %3.0f%% %6.2fs %3.0f%% %11llu\n",
+               r.name, r.mb_per_sec, r.p50, r.p90, r.p99, r.p999, r.max,
+               r.client_cpu, 100 * r.client_cpu / r.wall_secs, r.server_cpu, 100 * r.server_cpu / r.wall_secs,
+               (unsigned long long)r.retransmits);
+        fflush(stdout);
+    }
+
+    printf("\nCPU is user+system time over the whole run, and as a percentage of its wall time.\n");
+    free(payload);
+    return failed ? EXIT_FAILURE : 0;
+}
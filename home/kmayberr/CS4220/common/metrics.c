@@ -0,0 +1,281 @@
+/***********************************************************************
+ * metrics.c
+ *
+ * Shared slots, snapshot formatting and the exporter thread for the
+ * metrics declared in metrics.h.
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ ***********************************************************************/
+#include "metrics.h"
+
+#ifndef NO_METRICS
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Slots for every thread of every process, mapped before any worker is forked
+struct metrics_shared {
+    unsigned int nslots;    // Slots claimed so far
+    struct metrics_slot slots[METRICS_MAX_SLOTS];
+};
+
+static const char *counter_names[M_COUNTER_COUNT] = {
+    "bytes_sent", "bytes_received", "packets_sent", "packets_received", "packets_dropped",
+    "retransmits", "connections", "handshakes", "handshake_failures", "sessions_resumed", "requests"
+};
+
+static const char *histogram_names[M_HISTOGRAM_COUNT] = {
+    "handshake_us", "ttfb_us", "transfer_us", "queue_depth"
+};
+
+__thread struct metrics_slot *metrics_thread_slot;
+
+static struct metrics_shared *metrics;
+static struct metrics_slot overflow_slot; // Absorbs, and drops, metrics of threads beyond METRICS_MAX_SLOTS
+static char metrics_name[64] = "metrics";
+static uint64_t start_us;
+
+// A forked child must not keep writing the slot its parent thread owns
+static void reset_thread_slot(void) {
+    metrics_thread_slot = NULL;
+}
+
+void metrics_init(const char *name) {
+    metrics = mmap(NULL, sizeof(*metrics), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (metrics == MAP_FAILED) {
+        perror("Unable to map metrics");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(metrics_name, sizeof(metrics_name), "%s", name);
+    start_us = metrics_now_us();
+    pthread_atfork(NULL, NULL, reset_thread_slot);
+}
+
+struct metrics_slot *metrics_claim_slot(void) {
+    unsigned int i = metrics ? __atomic_fetch_add(&metrics->nslots, 1, __ATOMIC_RELAXED) : METRICS_MAX_SLOTS;
+    if (i >= METRICS_MAX_SLOTS) {
+        if (metrics) {
+            fprintf(stderr, "metrics: more than %d threads, extra threads are not counted\n", METRICS_MAX_SLOTS);
+        }
+        metrics_thread_slot = &overflow_slot;
+    } else {
+        metrics_thread_slot = &metrics->slots[i];
+    }
+    return metrics_thread_slot;
+}
+
+// Number of slots in use
+static unsigned int claimed_slots(void) {
+    unsigned int n = __atomic_load_n(&metrics->nslots, __ATOMIC_RELAXED);
+    return n < METRICS_MAX_SLOTS ? n : METRICS_MAX_SLOTS;
+}
+
+uint64_t metrics_counter_total(enum metric_counter c) {
+    uint64_t total = 0;
+    if (!metrics) {
+        return 0;
+    }
+    for (unsigned int i = 0; i < claimed_slots(); i++) {
+        total += __atomic_load_n(&metrics->slots[i].counters[c], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+// Representative value of a bucket: the middle of the range it covers
+static uint64_t bucket_value(int b) {
+    if (b < METRICS_SUB_BUCKETS) {
+        return b;
+    }
+    int shift = b / METRICS_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(METRICS_SUB_BUCKETS + b % METRICS_SUB_BUCKETS) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+// Value at quantile q of a merged histogram
+static uint64_t percentile(const struct metrics_histogram *h, double q) {
+    uint64_t rank = (uint64_t)(q * h->count);
+    uint64_t seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen > rank) {
+            uint64_t v = bucket_value(b);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+void metrics_write_snapshot(FILE *out) {
+    static struct metrics_histogram merged; // Too large for the stack; the lock serializes concurrent snapshots
+    static pthread_mutex_t merged_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    if (!metrics) {
+        return;
+    }
+    unsigned int n = claimed_slots();
+    fprintf(out, "# %s pid %d uptime_s %.1f threads %u\n", metrics_name, (int)getpid(),
+            (metrics_now_us() - start_us) / 1e6, n);
+
+    for (int c = 0; c < M_COUNTER_COUNT; c++) {
+        fprintf(out, "counter %s %llu\n", counter_names[c], (unsigned long long)metrics_counter_total(c));
+    }
+
+    pthread_mutex_lock(&merged_lock);
+    for (int h = 0; h < M_HISTOGRAM_COUNT; h++) {
+        memset(&merged, 0, sizeof(merged));
+        for (unsigned int i = 0; i < n; i++) {
+            const struct metrics_histogram *src = &metrics->slots[i].histograms[h];
+            uint64_t count = __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+            if (count == 0) {
+                continue;
+            }
+            merged.count += count;
+            merged.sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+            uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+            if (max > merged.max) {
+                merged.max = max;
+            }
+            for (int b = 0; b < METRICS_BUCKETS; b++) {
+                merged.buckets[b] += __atomic_load_n(&src->buckets[b], __ATOMIC_RELAXED);
+            }
+        }
+        // Buckets are read while writers keep going, so recount rather than trust count
+        uint64_t total = 0;
+        for (int b = 0; b < METRICS_BUCKETS; b++) {
+            total += merged.buckets[b];
+        }
+        merged.count = total;
+
+        if (merged.count == 0) {
+            fprintf(out, "histogram %s count 0\n", histogram_names[h]);
+            continue;
+        }
+        fprintf(out, "histogram %s count %llu mean %.1f p50 %llu p90 %llu p99 %llu p999 %llu max %llu\n",
+                histogram_names[h], (unsigned long long)merged.count, (double)merged.sum / merged.count,
+                (unsigned long long)percentile(&merged, 0.50), (unsigned long long)percentile(&merged, 0.90),
+                (unsigned long long)percentile(&merged, 0.99), (unsigned long long)percentile(&merged, 0.999),
+                (unsigned long long)merged.max);
+    }
+    pthread_mutex_unlock(&merged_lock);
+    fflush(out);
+}
+
+// Replace the snapshot file atomically so readers never see a partial snapshot
+static void write_snapshot_file(const char *path) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *out = fopen(tmp, "w");
+    if (!out) {
+        perror("metrics: unable to write snapshot");
+        return;
+    }
+    metrics_write_snapshot(out);
+    fclose(out);
+    if (rename(tmp, path) < 0) {
+        perror("metrics: unable to replace snapshot");
+    }
+}
+
+// Listen on a UNIX stream socket for snapshot requests; returns -1 on failure
+static int open_stats_socket(const char *path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("metrics: unable to create stats socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path); // Remove a socket left behind by an earlier run
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        perror("metrics: unable to bind stats socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Exporter settings, read from the environment by metrics_start_exporter()
+struct exporter {
+    char file[4096];    // Snapshot file, empty when disabled
+    int socket_fd;      // Listening stats socket, -1 when disabled
+    int interval_ms;
+};
+
+// Exporter thread: rewrite the snapshot file every interval and answer stats socket connections
+static void *exporter_main(void *arg) {
+    struct exporter *ex = arg;
+    uint64_t next_write = metrics_now_us();
+
+    while (1) {
+        uint64_t now = metrics_now_us();
+        if (now >= next_write) {
+            if (ex->file[0]) {
+                write_snapshot_file(ex->file);
+            }
+            next_write = now + ex->interval_ms * 1000ULL;
+        }
+
+        int timeout = (int)((next_write - now + 999) / 1000);
+        if (ex->socket_fd < 0) {
+            usleep(timeout * 1000);
+            continue;
+        }
+
+        struct pollfd pfd = { ex->socket_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout) > 0) {
+            int client = accept(ex->socket_fd, NULL, NULL);
+            if (client >= 0) {
+                FILE *out = fdopen(client, "w");
+                if (out) {
+                    metrics_write_snapshot(out);
+                    fclose(out); // Also closes client
+                } else {
+                    close(client);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+void metrics_start_exporter(void) {
+    static struct exporter ex;
+    const char *file = getenv("METRICS_FILE");
+    const char *sock = getenv("METRICS_SOCKET");
+    const char *interval = getenv("METRICS_INTERVAL");
+    pthread_t thread;
+
+    if (file) {
+        snprintf(ex.file, sizeof(ex.file), "%s", file);
+    } else {
+        snprintf(ex.file, sizeof(ex.file), "%s.metrics", metrics_name);
+    }
+    ex.socket_fd = (sock && sock[0]) ? open_stats_socket(sock) : -1;
+    ex.interval_ms = interval ? (int)(atof(interval) * 1000) : 1000;
+    if (ex.interval_ms < 10) {
+        ex.interval_ms = 10;
+    }
+    if (!ex.file[0] && ex.socket_fd < 0) {
+        return; // Nothing to export to
+    }
+
+    if (pthread_create(&thread, NULL, exporter_main, &ex) != 0) {
+        perror("metrics: unable to start exporter");
+        return;
+    }
+    pthread_detach(thread);
+}
+
+#endif
@@ -0,0 +1,155 @@
+/***********************************************************************
+ * metrics.h
+ *
+ * Low-overhead metrics shared by the TCP, Go-Back-N and HTTPS servers.
+ *
+ * Every thread that records a metric claims its own slot the first time it
+ * does so, and only that thread ever writes the slot, so recording is a few
+ * plain loads and stores with no locks or atomic read-modify-write. Readers
+ * sum all slots. The slots live in a MAP_SHARED mapping created by
+ * metrics_init(), so worker processes forked afterwards report into the
+ * same totals.
+ *
+ * Histograms are HDR-style log-linear: values below 16 get exact buckets,
+ * and every power of two above that is split into 16 linear sub-buckets,
+ * so any recorded value is known to within about 6%.
+ *
+ * The exporter thread writes a text snapshot every METRICS_INTERVAL
+ * seconds (default 1) to METRICS_FILE (default "<name>.metrics", empty to
+ * disable) and, if METRICS_SOCKET is set, answers every connection to that
+ * UNIX socket path with a fresh snapshot:  nc -U /tmp/server.sock
+ *
+ * Compile-time switches:
+ * - NO_PACKET_LOG removes the per-packet and per-connection PACKET_LOG()
+ *   printf calls from the hot paths.
+ * - NO_METRICS compiles every metrics call to nothing.
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ ***********************************************************************/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef NO_PACKET_LOG
+#define PACKET_LOG(...) ((void)0)
+#else
+#define PACKET_LOG(...) printf(__VA_ARGS__)
+#endif
+
+// Counters, summed over every thread and process
+enum metric_counter {
+    M_BYTES_SENT,
+    M_BYTES_RECEIVED,
+    M_PACKETS_SENT,
+    M_PACKETS_RECEIVED,
+    M_PACKETS_DROPPED,      // Lost to the simulated loss rate
+    M_RETRANSMITS,
+    M_CONNECTIONS,
+    M_HANDSHAKES,
+    M_HANDSHAKE_FAILURES,
+    M_SESSIONS_RESUMED,
+    M_REQUESTS,
+    M_COUNTER_COUNT
+};
+
+// Histograms of recorded values
+enum metric_histogram {
+    M_HANDSHAKE_US,         // SSL handshake duration in microseconds
+    M_TTFB_US,              // Accept to first response byte sent, in microseconds
+    M_TRANSFER_US,          // Duration of a whole transfer or request, in microseconds
+    M_QUEUE_DEPTH,          // Sampled queue or window occupancy
+    M_HISTOGRAM_COUNT
+};
+
+#define METRICS_MAX_SLOTS 256  // Threads that can record metrics across all processes
+#define METRICS_SUB_BITS 4  // log2 of the linear sub-buckets per power of two
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BITS)
+#define METRICS_BUCKETS ((64 - METRICS_SUB_BITS + 1) * METRICS_SUB_BUCKETS)
+
+// One histogram, written by a single thread
+struct metrics_histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[METRICS_BUCKETS];
+};
+
+// Everything one thread records, cache-line aligned so slots never share a line
+struct metrics_slot {
+    uint64_t counters[M_COUNTER_COUNT];
+    struct metrics_histogram histograms[M_HISTOGRAM_COUNT];
+} __attribute__((aligned(64)));
+
+#ifndef NO_METRICS
+
+extern __thread struct metrics_slot *metrics_thread_slot; // This thread's slot, NULL until claimed
+
+// Claim a slot for the calling thread (slow path of the recording functions)
+struct metrics_slot *metrics_claim_slot(void);
+
+// Map the shared slots; call once in main() before starting threads or forking workers
+void metrics_init(const char *name);
+
+// Start the background thread that writes snapshots to the file and/or socket
+void metrics_start_exporter(void);
+
+// Write a snapshot of all counters and histograms
+void metrics_write_snapshot(FILE *out);
+
+// Sum of one counter over all slots
+uint64_t metrics_counter_total(enum metric_counter c);
+
+// Add v to a counter
+static inline void metrics_add(enum metric_counter c, uint64_t v) {
+    struct metrics_slot *s = metrics_thread_slot ? metrics_thread_slot : metrics_claim_slot();
+    __atomic_store_n(&s->counters[c], s->counters[c] + v, __ATOMIC_RELAXED);
+}
+
+// Bucket index of a value in the log-linear histogram
+static inline int metrics_bucket(uint64_t value) {
+    if (value < METRICS_SUB_BUCKETS) {
+        return (int)value;
+    }
+    int shift = 63 - __builtin_clzll(value) - METRICS_SUB_BITS;
+    return (shift + 1) * METRICS_SUB_BUCKETS + (int)((value >> shift) & (METRICS_SUB_BUCKETS - 1));
+}
+
+// Record one value in a histogram
+static inline void metrics_record(enum metric_histogram h, uint64_t value) {
+    struct metrics_slot *s = metrics_thread_slot ? metrics_thread_slot : metrics_claim_slot();
+    struct metrics_histogram *hist = &s->histograms[h];
+    int b = metrics_bucket(value);
+    __atomic_store_n(&hist->buckets[b], hist->buckets[b] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->sum, hist->sum + value, __ATOMIC_RELAXED);
+    if (value > hist->max) {
+        __atomic_store_n(&hist->max, value, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&hist->count, hist->count + 1, __ATOMIC_RELAXED);
+}
+
+#else
+
+static inline void metrics_init(const char *name) { (void)name; }
+static inline void metrics_start_exporter(void) {}
+static inline void metrics_write_snapshot(FILE *out) { (void)out; }
+static inline uint64_t metrics_counter_total(enum metric_counter c) { (void)c; return 0; }
+static inline void metrics_add(enum metric_counter c, uint64_t v) { (void)c; (void)v; }
+static inline void metrics_record(enum metric_histogram h, uint64_t value) { (void)h; (void)value; }
+
+#endif
+
+// Current monotonic time in microseconds, for measuring durations
+static inline uint64_t metrics_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
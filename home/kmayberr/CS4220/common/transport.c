@@ -0,0 +1,89 @@
+/***********************************************************************
+ * transport.c
+ *
+ * Configuration defaults and the transport registry for transport.h.
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ ***********************************************************************/
+#include "transport.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const struct transport_ops *transports[] = { &tcp_transport, &rudp_transport, &tls_transport };
+
+void transport_config_init(struct transport_config *cfg) {
+    const char *value;
+
+    cfg->host = TRANSPORT_DEFAULT_HOST;
+    cfg->port = TRANSPORT_DEFAULT_PORT;
+    cfg->buffer_size = TRANSPORT_DEFAULT_BUFFER_SIZE;
+    cfg->cert_file = TRANSPORT_DEFAULT_CERT;
+    cfg->key_file = TRANSPORT_DEFAULT_KEY;
+    cfg->window_size = TRANSPORT_DEFAULT_WINDOW;
+    cfg->timeout_ms = TRANSPORT_DEFAULT_TIMEOUT_MS;
+    cfg->loss_rate = 0;
+
+    if ((value = getenv("TRANSPORT_HOST"))) {
+        cfg->host = value;
+    }
+    if ((value = getenv("TRANSPORT_PORT"))) {
+        cfg->port = atoi(value);
+    }
+    if ((value = getenv("TRANSPORT_BUFFER"))) {
+        cfg->buffer_size = strtoul(value, NULL, 10);
+    }
+    if ((value = getenv("TRANSPORT_CERT"))) {
+        cfg->cert_file = value;
+    }
+    if ((value = getenv("TRANSPORT_KEY"))) {
+        cfg->key_file = value;
+    }
+    if ((value = getenv("TRANSPORT_WINDOW"))) {
+        cfg->window_size = atoi(value);
+    }
+    if ((value = getenv("TRANSPORT_TIMEOUT_MS"))) {
+        cfg->timeout_ms = atoi(value);
+    }
+    if ((value = getenv("TRANSPORT_LOSS"))) {
+        cfg->loss_rate = atof(value);
+    }
+}
+
+const struct transport_ops *transport_find(const char *name) {
+    for (size_t i = 0; i < sizeof(transports) / sizeof(transports[0]); i++) {
+        if (strcmp(transports[i]->name, name) == 0) {
+            return transports[i];
+        }
+    }
+    return NULL;
+}
+
+const char *transport_names(void) {
+    static char names[256];
+    if (!names[0]) {
+        for (size_t i = 0; i < sizeof(transports) / sizeof(transports[0]); i++) {
+            if (i > 0) {
+                strcat(names, ",");
+            }
+            strcat(names, transports[i]->name);
+        }
+    }
+    return names;
+}
+
+ssize_t transport_recv_all(struct transport_conn *conn, void *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = transport_recv(conn, (char *)buf + got, len - got);
+        if (n <= 0) {
+            return n;
+        }
+        got += n;
+    }
+    return got;
+}
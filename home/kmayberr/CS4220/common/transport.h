@@ -0,0 +1,105 @@
+/***********************************************************************
+ * transport.h
+ *
+ * A small pluggable transport interface shared by the projects and the
+ * benchmark driver. Each transport provides the same listen / accept /
+ * connect / send / recv / close operations over a different protocol:
+ *
+ * - "tcp"  plain TCP sockets (Project 1)
+ * - "rudp" reliable UDP using the Go-Back-N packetStruct from Project 2
+ * - "tls"  TLS over TCP with OpenSSL (Project 3)
+ *
+ * Connections are byte streams: send() returns only once every byte has
+ * been handed to the transport (for rudp, once every packet is ACKed), and
+ * recv() returns up to len bytes, 0 at end of stream, or -1 on error.
+ * rudp connections are half duplex: the receiver holds only one packet
+ * that recv() has not consumed, so the two sides must take turns sending,
+ * and a send() to a peer that is not reading fails after RUDP_MAX_TRIES
+ * retransmission timeouts.
+ * Errors are reported with perror()/ERR_print_errors_fp() and a -1 or NULL
+ * return; nothing in the library calls exit().
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ ***********************************************************************/
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define TRANSPORT_DEFAULT_HOST "127.0.0.1"
+#define TRANSPORT_DEFAULT_PORT 14250
+#define TRANSPORT_DEFAULT_BUFFER_SIZE 65536
+#define TRANSPORT_DEFAULT_CERT "certs/server.crt"
+#define TRANSPORT_DEFAULT_KEY "certs/server.key"
+#define TRANSPORT_DEFAULT_WINDOW 64  // Go-Back-N window, in packets
+#define TRANSPORT_DEFAULT_TIMEOUT_MS 200  // Go-Back-N retransmission timeout
+
+// Settings every transport reads instead of hardcoding them in main()
+struct transport_config {
+    const char *host;        // Address to connect to
+    int port;                // Port to listen on or connect to
+    size_t buffer_size;      // Application read/write chunk size
+    const char *cert_file;   // TLS server certificate (PEM)
+    const char *key_file;    // TLS server private key (PEM)
+    int window_size;         // rudp: packets in flight
+    int timeout_ms;          // rudp: retransmission timeout
+    double loss_rate;        // rudp: simulated loss of incoming packets, 0 to 0.99
+};
+
+struct transport_ops;
+
+// Common header of every listener and connection; each transport extends it
+struct transport_conn {
+    const struct transport_ops *ops;
+};
+
+// Operations a transport implements
+struct transport_ops {
+    const char *name;
+    struct transport_conn *(*listen)(const struct transport_config *cfg);
+    struct transport_conn *(*accept)(struct transport_conn *listener);
+    struct transport_conn *(*connect)(const struct transport_config *cfg);
+    ssize_t (*send)(struct transport_conn *conn, const void *buf, size_t len);
+    ssize_t (*recv)(struct transport_conn *conn, void *buf, size_t len);
+    void (*close)(struct transport_conn *conn); // Closes listeners and connections
+};
+
+extern const struct transport_ops tcp_transport;
+extern const struct transport_ops rudp_transport;
+extern const struct transport_ops tls_transport;
+
+// Fill cfg with the defaults above, then apply TRANSPORT_HOST, TRANSPORT_PORT,
+// TRANSPORT_BUFFER, TRANSPORT_CERT, TRANSPORT_KEY, TRANSPORT_WINDOW,
+// TRANSPORT_TIMEOUT_MS and TRANSPORT_LOSS from the environment
+void transport_config_init(struct transport_config *cfg);
+
+// Look up a transport by name; returns NULL if there is none
+const struct transport_ops *transport_find(const char *name);
+
+// Names of all transports, comma separated, for usage messages
+const char *transport_names(void);
+
+static inline ssize_t transport_send(struct transport_conn *conn, const void *buf, size_t len) {
+    return conn->ops->send(conn, buf, len);
+}
+
+static inline ssize_t transport_recv(struct transport_conn *conn, void *buf, size_t len) {
+    return conn->ops->recv(conn, buf, len);
+}
+
+static inline void transport_close(struct transport_conn *conn) {
+    conn->ops->close(conn);
+}
+
+// Socket of a "tcp" connection or listener, for transports layered on top of TCP
+int transport_tcp_fd(struct transport_conn *conn);
+
+// Receive exactly len bytes; returns len, 0 if the stream ended first, or -1 on error
+ssize_t transport_recv_all(struct transport_conn *conn, void *buf, size_t len);
+
+#endif
@@ -0,0 +1,501 @@
+/***********************************************************************
+ * transport_rudp.c
+ *
+ * The "rudp" transport: a reliable byte stream over UDP using Go-Back-N
+ * with the packetStruct from Project 2.
+ *
+ * - Data packets (type 1) carry up to 512 bytes and consecutive sequence
+ *   numbers; ACKs (type 2) are cumulative and name the highest sequence
+ *   number received in order. The receiver discards anything out of order.
+ * - The sender keeps up to window_size packets in flight and resends all of
+ *   them when the oldest is not ACKed within timeout_ms. send() fails after
+ *   RUDP_MAX_TRIES timeouts in a row without progress.
+ * - The receiver buffers a single packet, so a side that is not reading
+ *   cannot accept more than one packet: the two sides must not send at the
+ *   same time (see transport.h).
+ * - Connection setup works like TFTP: the client sends a SYN (type 3) to
+ *   the listening port, the server answers from a fresh socket, and both
+ *   sides then connect() their UDP sockets to each other. The SYN carries a
+ *   random client nonce; the listener remembers recent (address, nonce)
+ *   pairs so a retransmitted SYN re-sends the existing reply instead of
+ *   creating a second connection.
+ * - A FIN (type 4) carries the next sequence number and ends the stream.
+ *   Its data holds the sender's cumulative ACK, so a peer still waiting on
+ *   a lost ACK for its last packets is released by the FIN itself.
+ * - Packet fields are sent in host byte order, like the Project 2 programs.
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ ***********************************************************************/
+#include "transport.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "../Project_2_GoBackN/packetStruct.c"  // Go-Back-N packet structure
+
+#define PKT_DATA 1  // Packet types; 1 and 2 match Project 2
+#define PKT_ACK 2
+#define PKT_SYN 3
+#define PKT_FIN 4
+
+#define RUDP_PAYLOAD ((int)sizeof(((struct packetStruct *)0)->data))
+#define RUDP_HEADER ((int)offsetof(struct packetStruct, data))
+#define RUDP_MAX_TRIES 20  // Retransmissions of a SYN, FIN or unacknowledged window before giving up
+#define RUDP_IDLE_TIMEOUT_MS 30000  // recv() gives up after this long without a packet
+#define RUDP_SOCKET_BUFFER (4 * 1024 * 1024)  // Room for a full window of packets in the kernel
+#define RUDP_RECENT_SYNS 16  // Accepted SYNs a listener remembers to recognise retransmissions
+
+struct rudp_conn;
+
+// A SYN the listener accepted, and the connection it created while that connection is open
+struct rudp_syn {
+    struct sockaddr_in addr;
+    uint32_t nonce;
+    struct rudp_conn *conn;
+};
+
+struct rudp_conn {
+    struct transport_conn base;
+    int fd;
+    int listener;            // 1 for a listening socket, which only accepts SYNs
+    int window_size;
+    int timeout_ms;
+    double loss_rate;
+    int next_seq;            // Next sequence number this side sends
+    int expected_seq;        // Next sequence number expected from the peer
+    int synack_pending;      // Server side: resend the SYN reply until the client's first packet arrives
+    uint32_t syn_nonce;      // Client nonce from the SYN, echoed in the SYN reply
+    int peer_closed;         // The peer's FIN has been received
+    int pending_off, pending_len;  // Bytes of a received packet not yet returned by recv()
+    char pending[sizeof(((struct packetStruct *)0)->data)];
+    struct rudp_syn *syn;    // Accepted connection: the listener's record of its SYN, if the listener is open
+    struct rudp_syn recent[RUDP_RECENT_SYNS];  // Listener: recently accepted SYNs
+    int next_recent;         // Listener: slot the next accepted SYN replaces
+};
+
+// Create a UDP socket with buffers big enough for a full window
+static int rudp_socket(void) {
+    int size = RUDP_SOCKET_BUFFER;
+    int fd = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        perror("socket() failed");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    return fd;
+}
+
+// Allocate a connection around a socket
+static struct rudp_conn *rudp_wrap(int fd, const struct transport_config *cfg) {
+    struct rudp_conn *c = calloc(1, sizeof(*c));
+    if (!c) {
+        perror("Unable to allocate connection");
+        close(fd);
+        return NULL;
+    }
+    c->base.ops = &rudp_transport;
+    c->fd = fd;
+    c->window_size = cfg->window_size > 0 ? cfg->window_size : 1;
+    c->timeout_ms = cfg->timeout_ms > 0 ? cfg->timeout_ms : TRANSPORT_DEFAULT_TIMEOUT_MS;
+    c->loss_rate = cfg->loss_rate;
+    return c;
+}
+
+// Send one packet on the connected socket; returns 0 or -1
+static int rudp_send_packet(struct rudp_conn *c, int type, int seq_no, const void *data, int length) {
+    struct packetStruct packet;
+    packet.type = type;
+    packet.seq_no = seq_no;
+    packet.length = length;
+    if (length > 0) {
+        memcpy(packet.data, data, length);
+    }
+    if (send(c->fd, &packet, RUDP_HEADER + length, 0) < 0) {
+        if (errno != ECONNREFUSED) {
+            perror("sendto() failed");
+        }
+        return -1;
+    }
+    metrics_add(M_PACKETS_SENT, 1);
+    return 0;
+}
+
+// Acknowledge everything received in order so far
+static void rudp_send_ack(struct rudp_conn *c) {
+    rudp_send_packet(c, PKT_ACK, c->expected_seq - 1, NULL, 0);
+}
+
+// Wait up to timeout_ms for a packet that survives simulated loss; returns 1, 0 on timeout, -1 on error
+static int rudp_wait(struct rudp_conn *c, struct packetStruct *packet, int timeout_ms) {
+    uint64_t deadline = metrics_now_us() + (uint64_t)timeout_ms * 1000;
+
+    while (1) {
+        uint64_t now = metrics_now_us();
+        if (now >= deadline) {
+            return 0;
+        }
+        struct pollfd pfd = { c->fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, (int)((deadline - now + 999) / 1000));
+        if (ready < 0 && errno != EINTR) {
+            perror("poll() failed");
+            return -1;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        ssize_t n = recv(c->fd, packet, sizeof(*packet), 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != ECONNREFUSED) {
+                perror("recvfrom() failed");
+            }
+            return -1;
+        }
+        if (n < RUDP_HEADER || packet->length < 0 || packet->length > RUDP_PAYLOAD ||
+            n < RUDP_HEADER + packet->length) {
+            continue; // Malformed
+        }
+        metrics_add(M_PACKETS_RECEIVED, 1);
+        if (c->loss_rate > ((double)rand() / RAND_MAX)) {
+            metrics_add(M_PACKETS_DROPPED, 1); // Simulate packet loss, as in Project 2
+            continue;
+        }
+        c->synack_pending = 0; // Any packet from the client means it got our SYN reply
+        return 1;
+    }
+}
+
+// Handle a data or FIN packet that arrived; in-order data is kept for recv() if there is room
+static void rudp_handle_incoming(struct rudp_conn *c, struct packetStruct *packet) {
+    if (packet->seq_no == c->expected_seq && !c->peer_closed) {
+        if (packet->type == PKT_FIN) {
+            c->expected_seq++;
+            c->peer_closed = 1;
+        } else if (c->pending_len == 0) {
+            memcpy(c->pending, packet->data, packet->length);
+            c->pending_off = 0;
+            c->pending_len = packet->length;
+            c->expected_seq++;
+        }
+    }
+    rudp_send_ack(c); // Go-Back-N: always (re)acknowledge the last in-order packet
+}
+
+static struct transport_conn *rudp_listen(const struct transport_config *cfg) {
+    struct sockaddr_in addr;
+    int fd = rudp_socket();
+    if (fd < 0) {
+        return NULL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(cfg->host);
+    addr.sin_port = htons(cfg->port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind() failed");
+        close(fd);
+        return NULL;
+    }
+
+    struct rudp_conn *c = rudp_wrap(fd, cfg);
+    if (c) {
+        c->listener = 1;
+    }
+    return c ? &c->base : NULL;
+}
+
+static struct transport_conn *rudp_accept(struct transport_conn *listener) {
+    struct rudp_conn *l = (struct rudp_conn *)listener;
+    struct packetStruct packet;
+    struct sockaddr_in client_addr, local_addr;
+    socklen_t addr_len;
+    uint32_t nonce;
+
+    // Wait for a SYN on the listening socket that is not a retransmission of one already accepted
+    while (1) {
+        addr_len = sizeof(client_addr);
+        ssize_t n = recvfrom(l->fd, &packet, sizeof(packet), 0, (struct sockaddr *)&client_addr, &addr_len);
+        if (n < 0) {
+            perror("recvfrom() failed");
+            return NULL;
+        }
+        if (n < RUDP_HEADER + (int)sizeof(nonce) || packet.type != PKT_SYN || packet.length != sizeof(nonce)) {
+            continue;
+        }
+        memcpy(&nonce, packet.data, sizeof(nonce));
+
+        struct rudp_syn *seen = NULL;
+        for (int i = 0; i < RUDP_RECENT_SYNS && !seen; i++) {
+            struct rudp_syn *syn = &l->recent[i];
+            if (syn->nonce == nonce && syn->addr.sin_addr.s_addr == client_addr.sin_addr.s_addr &&
+                syn->addr.sin_port == client_addr.sin_port) {
+                seen = syn;
+            }
+        }
+        if (!seen) {
+            break;
+        }
+        if (seen->conn && seen->conn->synack_pending) {
+            rudp_send_packet(seen->conn, PKT_SYN, 0, &nonce, sizeof(nonce)); // Our reply was lost
+        }
+    }
+
+    // Answer from a fresh socket on the same address so the listener stays free for other clients
+    int fd = rudp_socket();
+    if (fd < 0) {
+        return NULL;
+    }
+    addr_len = sizeof(local_addr);
+    getsockname(l->fd, (struct sockaddr *)&local_addr, &addr_len);
+    local_addr.sin_port = 0;
+    if (bind(fd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0 ||
+        connect(fd, (struct sockaddr *)&client_addr, sizeof(client_addr)) < 0) {
+        perror("connect() failed");
+        close(fd);
+        return NULL;
+    }
+
+    struct transport_config cfg = { .window_size = l->window_size, .timeout_ms = l->timeout_ms,
+                                     .loss_rate = l->loss_rate };
+    struct rudp_conn *c = rudp_wrap(fd, &cfg);
+    if (!c) {
+        return NULL;
+    }
+    c->synack_pending = 1;
+    c->syn_nonce = nonce;
+    rudp_send_packet(c, PKT_SYN, 0, &nonce, sizeof(nonce));
+    metrics_add(M_CONNECTIONS, 1);
+
+    // Remember the SYN, replacing the oldest record
+    struct rudp_syn *syn = &l->recent[l->next_recent];
+    l->next_recent = (l->next_recent + 1) % RUDP_RECENT_SYNS;
+    if (syn->conn) {
+        syn->conn->syn = NULL;
+    }
+    syn->addr = client_addr;
+    syn->nonce = nonce;
+    syn->conn = c;
+    c->syn = syn;
+    return &c->base;
+}
+
+static struct transport_conn *rudp_connect(const struct transport_config *cfg) {
+    struct sockaddr_in server_addr, from_addr;
+    struct packetStruct packet;
+    socklen_t addr_len;
+    int fd = rudp_socket();
+    if (fd < 0) {
+        return NULL;
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = inet_addr(cfg->host);
+    server_addr.sin_port = htons(cfg->port);
+    memset(&packet, 0, sizeof(packet));
+    packet.type = PKT_SYN;
+    packet.length = sizeof(uint32_t);
+    if (getrandom(packet.data, sizeof(uint32_t), 0) != sizeof(uint32_t)) {
+        perror("getrandom() failed");
+        close(fd);
+        return NULL;
+    }
+
+    // Send SYNs until the server answers, then talk only to the socket that answered
+    for (int tries = 0; tries < RUDP_MAX_TRIES; tries++) {
+        if (sendto(fd, &packet, RUDP_HEADER + packet.length, 0, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+            perror("sendto() failed");
+            break;
+        }
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, cfg->timeout_ms) <= 0) {
+            continue;
+        }
+        struct packetStruct reply;
+        addr_len = sizeof(from_addr);
+        if (recvfrom(fd, &reply, sizeof(reply), 0, (struct sockaddr *)&from_addr, &addr_len) <
+                RUDP_HEADER + packet.length ||
+            reply.type != PKT_SYN || memcmp(reply.data, packet.data, packet.length) != 0) {
+            continue; // Not the reply to this SYN
+        }
+        if (connect(fd, (struct sockaddr *)&from_addr, sizeof(from_addr)) < 0) {
+            perror("connect() failed");
+            break;
+        }
+        struct rudp_conn *c = rudp_wrap(fd, cfg);
+        return c ? &c->base : NULL;
+    }
+
+    fprintf(stderr, "No reply from rudp server %s:%d.\n", cfg->host, cfg->port);
+    close(fd);
+    return NULL;
+}
+
+static ssize_t rudp_send(struct transport_conn *conn, const void *buf, size_t len) {
+    struct rudp_conn *c = (struct rudp_conn *)conn;
+    struct packetStruct packet;
+    int first = c->next_seq;
+    int end = first + (int)((len + RUDP_PAYLOAD - 1) / RUDP_PAYLOAD);
+    int base = first;   // Oldest unacknowledged packet
+    int next = first;   // Next packet to send for the first time
+    int timeouts = 0;   // Timeouts in a row without an ACK advancing base
+    uint64_t timer = metrics_now_us();
+
+    while (base < end) {
+        // Fill the window
+        while (next < end && next - base < c->window_size) {
+            size_t offset = (size_t)(next - first) * RUDP_PAYLOAD;
+            int length = len - offset < (size_t)RUDP_PAYLOAD ? (int)(len - offset) : RUDP_PAYLOAD;
+            if (rudp_send_packet(c, PKT_DATA, next, (const char *)buf + offset, length) < 0) {
+                return -1;
+            }
+            next++;
+        }
+
+        uint64_t now = metrics_now_us();
+        int remaining = (int)(((int64_t)timer + c->timeout_ms * 1000LL - (int64_t)now) / 1000);
+        int got = remaining > 0 ? rudp_wait(c, &packet, remaining) : 0;
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            if (++timeouts >= RUDP_MAX_TRIES) {
+                fprintf(stderr, "rudp packet %d not acknowledged after %d tries, giving up.\n", base, timeouts);
+                return -1;
+            }
+            // Timeout: Go-Back-N resends every packet in flight
+            metrics_add(M_RETRANSMITS, next - base);
+            if (c->synack_pending) {
+                rudp_send_packet(c, PKT_SYN, 0, &c->syn_nonce, sizeof(c->syn_nonce));
+            }
+            next = base;
+            timer = metrics_now_us();
+            continue;
+        }
+
+        if (packet.type == PKT_ACK) {
+            if (packet.seq_no >= base && packet.seq_no < next) {
+                metrics_record(M_QUEUE_DEPTH, next - base); // Packets in flight when the ACK arrived
+                base = packet.seq_no + 1;
+                timer = metrics_now_us();
+                timeouts = 0;
+            }
+        } else if (packet.type == PKT_DATA || packet.type == PKT_FIN) {
+            int ack;
+            if (packet.type == PKT_FIN && packet.length == (int)sizeof(ack)) {
+                memcpy(&ack, packet.data, sizeof(ack)); // The peer closed after receiving up to ack
+                if (ack >= base && ack < next) {
+                    base = ack + 1;
+                    timer = metrics_now_us();
+                    timeouts = 0;
+                }
+            }
+            rudp_handle_incoming(c, &packet); // The peer may still be retransmitting its last packets
+        }
+    }
+
+    c->next_seq = end;
+    metrics_add(M_BYTES_SENT, len);
+    return len;
+}
+
+static ssize_t rudp_recv(struct transport_conn *conn, void *buf, size_t len) {
+    struct rudp_conn *c = (struct rudp_conn *)conn;
+    struct packetStruct packet;
+    int idle_ms = 0;
+
+    while (c->pending_len == 0 && !c->peer_closed) {
+        int got = rudp_wait(c, &packet, c->timeout_ms);
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            if (c->synack_pending) {
+                rudp_send_packet(c, PKT_SYN, 0, &c->syn_nonce, sizeof(c->syn_nonce));
+            }
+            idle_ms += c->timeout_ms;
+            if (idle_ms >= RUDP_IDLE_TIMEOUT_MS) {
+                fprintf(stderr, "rudp peer silent for %d ms, giving up.\n", idle_ms);
+                return -1;
+            }
+            continue;
+        }
+        idle_ms = 0;
+        if (packet.type == PKT_DATA || packet.type == PKT_FIN) {
+            rudp_handle_incoming(c, &packet);
+        }
+        // Late ACKs and duplicate SYN replies need no answer
+    }
+
+    if (c->pending_len == 0) {
+        return 0; // The peer closed the stream
+    }
+    size_t n = len < (size_t)c->pending_len ? len : (size_t)c->pending_len;
+    memcpy(buf, c->pending + c->pending_off, n);
+    c->pending_off += n;
+    c->pending_len -= n;
+    metrics_add(M_BYTES_RECEIVED, n);
+    return n;
+}
+
+static void rudp_close(struct transport_conn *conn) {
+    struct rudp_conn *c = (struct rudp_conn *)conn;
+    struct packetStruct packet;
+
+    // Send a FIN until it is acknowledged, still answering the peer's own retransmissions meanwhile
+    if (!c->listener) {
+        int fin_seq = c->next_seq;
+        for (int tries = 0; tries < RUDP_MAX_TRIES; tries++) {
+            int ack = c->expected_seq - 1;
+            if (rudp_send_packet(c, PKT_FIN, fin_seq, &ack, sizeof(ack)) < 0) {
+                break; // The peer's socket is already gone
+            }
+            int got;
+            while ((got = rudp_wait(c, &packet, c->timeout_ms)) > 0) {
+                if (packet.type == PKT_ACK && packet.seq_no >= fin_seq) {
+                    break;
+                }
+                if (packet.type == PKT_DATA || packet.type == PKT_FIN) {
+                    rudp_handle_incoming(c, &packet);
+                }
+            }
+            if (got != 0) {
+                break; // Acknowledged, or the peer's socket is gone
+            }
+        }
+    }
+
+    // Unlink the connection and its listener's record of its SYN, whichever closes first
+    if (c->syn) {
+        c->syn->conn = NULL;
+    }
+    for (int i = 0; c->listener && i < RUDP_RECENT_SYNS; i++) {
+        if (c->recent[i].conn) {
+            c->recent[i].conn->syn = NULL;
+        }
+    }
+    close(c->fd);
+    free(c);
+}
+
+const struct transport_ops rudp_transport = {
+    "rudp", rudp_listen, rudp_accept, rudp_connect, rudp_send, rudp_recv, rudp_close
+};
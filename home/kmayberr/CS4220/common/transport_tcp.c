@@ -0,0 +1,148 @@
+/***********************************************************************
+ * transport_tcp.c
+ *
+ * The "tcp" transport: plain TCP stream sockets, as in Project 1.
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ ***********************************************************************/
+#include "transport.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+struct tcp_conn {
+    struct transport_conn base;
+    int fd;
+};
+
+// Wrap a connected or listening socket
+static struct transport_conn *tcp_wrap(int fd) {
+    struct tcp_conn *c = calloc(1, sizeof(*c));
+    if (!c) {
+        perror("[-] Unable to allocate connection");
+        close(fd);
+        return NULL;
+    }
+    c->base.ops = &tcp_transport;
+    c->fd = fd;
+    return &c->base;
+}
+
+// Disable Nagle so small request/response messages are not delayed
+static void tcp_nodelay(int fd) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+static struct transport_conn *tcp_listen(const struct transport_config *cfg) {
+    struct sockaddr_in addr;
+    int on = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("[-] Socket error");
+        return NULL;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg->port);
+    addr.sin_addr.s_addr = inet_addr(cfg->host);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        perror("[-] Bind error");
+        close(fd);
+        return NULL;
+    }
+    return tcp_wrap(fd);
+}
+
+static struct transport_conn *tcp_accept(struct transport_conn *listener) {
+    struct tcp_conn *l = (struct tcp_conn *)listener;
+    int fd = accept(l->fd, NULL, NULL);
+    if (fd < 0) {
+        perror("[-] Accept error");
+        return NULL;
+    }
+    tcp_nodelay(fd);
+    metrics_add(M_CONNECTIONS, 1);
+    return tcp_wrap(fd);
+}
+
+static struct transport_conn *tcp_connect(const struct transport_config *cfg) {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("[-] Socket error");
+        return NULL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg->port);
+    addr.sin_addr.s_addr = inet_addr(cfg->host);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("[-] Connect error");
+        close(fd);
+        return NULL;
+    }
+    tcp_nodelay(fd);
+    return tcp_wrap(fd);
+}
+
+static ssize_t tcp_send(struct transport_conn *conn, const void *buf, size_t len) {
+    struct tcp_conn *c = (struct tcp_conn *)conn;
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(c->fd, (const char *)buf + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("[-] Send error");
+            return -1;
+        }
+        sent += n;
+    }
+    metrics_add(M_BYTES_SENT, len);
+    return len;
+}
+
+static ssize_t tcp_recv(struct transport_conn *conn, void *buf, size_t len) {
+    struct tcp_conn *c = (struct tcp_conn *)conn;
+    ssize_t n;
+    do {
+        n = recv(c->fd, buf, len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        perror("[-] Receive error");
+    } else {
+        metrics_add(M_BYTES_RECEIVED, n);
+    }
+    return n;
+}
+
+int transport_tcp_fd(struct transport_conn *conn) {
+    return ((struct tcp_conn *)conn)->fd;
+}
+
+static void tcp_close(struct transport_conn *conn) {
+    struct tcp_conn *c = (struct tcp_conn *)conn;
+    close(c->fd);
+    free(c);
+}
+
+const struct transport_ops tcp_transport = {
+    "tcp", tcp_listen, tcp_accept, tcp_connect, tcp_send, tcp_recv, tcp_close
+};
@@ -0,0 +1,207 @@
+/***********************************************************************
+ * transport_tls.c
+ *
+ * The "tls" transport: TLS over TCP with OpenSSL, as in Project 3.
+ *
+ * The server loads cfg->cert_file and cfg->key_file. If they cannot be
+ * read, it generates a throwaway self-signed RSA certificate so that the
+ * benchmark also runs without a certs directory. The client does not
+ * verify the certificate, matching http_client.c.
+ *
+ * Authors: Kory Mayberry, Ashley Judson, Nathan Peckham
+ *
+ * University of Colorado Springs
+ * Course: CS 4220 Networks Spring 2024
+ * Instructor: Dr. Serena Sullivan
+ ***********************************************************************/
+#include "transport.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+struct tls_conn {
+    struct transport_conn base;
+    struct transport_conn *tcp;  // Underlying TCP connection or listener
+    SSL_CTX *ctx;                // Owned by listeners and client connections
+    SSL *ssl;                    // NULL for listeners
+};
+
+// Give the server context a freshly generated self-signed RSA certificate
+static int use_ephemeral_certificate(SSL_CTX *ctx) {
+    EVP_PKEY *pkey = EVP_RSA_gen(2048);
+    X509 *cert = X509_new();
+    int ok = 0;
+
+    if (pkey && cert) {
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+        X509_set_pubkey(cert, pkey);
+        X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                                   (const unsigned char *)"localhost", -1, -1, 0);
+        X509_set_issuer_name(cert, X509_get_subject_name(cert));
+        ok = X509_sign(cert, pkey, EVP_sha256()) > 0 &&
+             SSL_CTX_use_certificate(ctx, cert) == 1 &&
+             SSL_CTX_use_PrivateKey(ctx, pkey) == 1;
+    }
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+
+// Wrap a TCP connection or listener
+static struct tls_conn *tls_wrap(struct transport_conn *tcp, SSL_CTX *ctx) {
+    struct tls_conn *c = calloc(1, sizeof(*c));
+    if (!c) {
+        perror("Unable to allocate connection");
+        return NULL;
+    }
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    if (ctx) {
+        // A peer closing without close_notify ends the stream like any other EOF
+        SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+    }
+#endif
+    c->base.ops = &tls_transport;
+    c->tcp = tcp;
+    c->ctx = ctx;
+    return c;
+}
+
+static struct transport_conn *tls_listen(const struct transport_config *cfg) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx) {
+        ERR_print_errors_fp(stderr);
+        return NULL;
+    }
+    if (SSL_CTX_use_certificate_file(ctx, cfg->cert_file, SSL_FILETYPE_PEM) <= 0 ||
+        SSL_CTX_use_PrivateKey_file(ctx, cfg->key_file, SSL_FILETYPE_PEM) <= 0) {
+        ERR_clear_error();
+        fprintf(stderr, "Unable to load %s / %s, using a temporary self-signed certificate.\n",
+                cfg->cert_file, cfg->key_file);
+        if (!use_ephemeral_certificate(ctx)) {
+            ERR_print_errors_fp(stderr);
+            SSL_CTX_free(ctx);
+            return NULL;
+        }
+    }
+
+    struct transport_conn *tcp = tcp_transport.listen(cfg);
+    if (!tcp) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    struct tls_conn *c = tls_wrap(tcp, ctx);
+    if (!c) {
+        transport_close(tcp);
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    return &c->base;
+}
+
+static struct transport_conn *tls_accept(struct transport_conn *listener) {
+    struct tls_conn *l = (struct tls_conn *)listener;
+    struct transport_conn *tcp = tcp_transport.accept(l->tcp);
+    if (!tcp) {
+        return NULL;
+    }
+
+    struct tls_conn *c = tls_wrap(tcp, NULL);
+    if (!c) {
+        transport_close(tcp);
+        return NULL;
+    }
+    c->ssl = SSL_new(l->ctx);
+    SSL_set_fd(c->ssl, transport_tcp_fd(tcp));
+
+    uint64_t start = metrics_now_us();
+    if (SSL_accept(c->ssl) <= 0) {
+        ERR_print_errors_fp(stderr);
+        metrics_add(M_HANDSHAKE_FAILURES, 1);
+        transport_close(&c->base);
+        return NULL;
+    }
+    metrics_add(M_HANDSHAKES, 1);
+    metrics_record(M_HANDSHAKE_US, metrics_now_us() - start);
+    return &c->base;
+}
+
+static struct transport_conn *tls_connect(const struct transport_config *cfg) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    if (!ctx) {
+        ERR_print_errors_fp(stderr);
+        return NULL;
+    }
+    struct transport_conn *tcp = tcp_transport.connect(cfg);
+    if (!tcp) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    struct tls_conn *c = tls_wrap(tcp, ctx);
+    if (!c) {
+        transport_close(tcp);
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    c->ssl = SSL_new(ctx);
+    SSL_set_fd(c->ssl, transport_tcp_fd(tcp));
+    if (SSL_connect(c->ssl) != 1) {
+        ERR_print_errors_fp(stderr);
+        transport_close(&c->base);
+        return NULL;
+    }
+    return &c->base;
+}
+
+static ssize_t tls_send(struct transport_conn *conn, const void *buf, size_t len) {
+    struct tls_conn *c = (struct tls_conn *)conn;
+    size_t written;
+    if (len == 0) {
+        return 0;
+    }
+    if (SSL_write_ex(c->ssl, buf, len, &written) != 1) {
+        ERR_print_errors_fp(stderr);
+        return -1;
+    }
+    metrics_add(M_BYTES_SENT, written);
+    return written;
+}
+
+static ssize_t tls_recv(struct transport_conn *conn, void *buf, size_t len) {
+    struct tls_conn *c = (struct tls_conn *)conn;
+    size_t got;
+    if (SSL_read_ex(c->ssl, buf, len, &got) != 1) {
+        int err = SSL_get_error(c->ssl, 0);
+        if (err == SSL_ERROR_ZERO_RETURN) {
+            return 0; // The peer sent close_notify
+        }
+        ERR_print_errors_fp(stderr);
+        return -1;
+    }
+    metrics_add(M_BYTES_RECEIVED, got);
+    return got;
+}
+
+static void tls_close(struct transport_conn *conn) {
+    struct tls_conn *c = (struct tls_conn *)conn;
+    if (c->ssl) {
+        SSL_shutdown(c->ssl);
+        SSL_free(c->ssl);
+    }
+    SSL_CTX_free(c->ctx); // NULL for accepted connections, which share the listener's context
+    transport_close(c->tcp);
+    free(c);
+}
+
+const struct transport_ops tls_transport = {
+    "tls", tls_listen, tls_accept, tls_connect, tls_send, tls_recv, tls_close
+};